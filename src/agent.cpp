@@ -2,197 +2,325 @@
  * @file agent.cpp
  * @brief How the Agent finds its move.
  *
- * The agent files are used to produce the best move for the black team. Finding the best move requires looking at how a move affects mobility, structuring of pieces, and whether or not you take or lose pieces. This is all calculated in the function evaluate(). This function is called on every move that the minimax algorithm (with alpha beta pruning) passes it. The minimax algorithm is used to allow the agent to search X moves ahead and figure out which produces the best possible outcome for itself, and the worst possible outcome for the other player. Each move/new gamestate is represented within a Node, and each Node hold a vector of other Nodes.
+ * The agent files are used to produce the best move for the black team. Finding the best move requires looking at how a move affects mobility, structuring of pieces, and whether or not you take or lose pieces. This is all calculated in the function evaluate(). This function is called on every move that the minimax algorithm (with alpha beta pruning) passes it. The minimax algorithm is used to allow the agent to search X moves ahead and figure out which produces the best possible outcome for itself, and the worst possible outcome for the other player. The search is depth first: each position's moves are generated into a MoveList on the stack only when the search reaches it, so an alpha beta cutoff skips generating the rest of that branch, and memory use grows with the depth rather than the size of the tree. The Agent keeps a single Chessboard and walks it up and down the search with make_move() and unmake_move(). Every searched position's result is stored in a TranspositionTable, so a position reached again through another move order can reuse it instead of being searched from scratch.
  *
  */
 #include "agent.h"
 
+#include <algorithm>
 #include <climits>
+#include <cmath>
+#include <thread>
+#include <utility>
+
+#include "see.h"
+
+namespace {
+/// Bonus for a rook on a column with no pawns, and on one with only enemy pawns
+constexpr PsqScore ROOK_OPEN_FILE_BONUS = {20, 10};
+constexpr PsqScore ROOK_SEMI_OPEN_FILE_BONUS = {10, 5};
+
+/// Outside every possible score, mates included
+constexpr int INFINITE_SCORE = MATE_SCORE + 1;
+/// Extra material a capture is assumed to win for positional gains when delta pruning in quiescence()
+constexpr int DELTA_MARGIN = 200;
+/// How far (per ply of depth left) the static evaluation must be from the window for futility pruning
+constexpr int FUTILITY_MARGIN = 150;
+/// Half width of the first aspiration window, doubled each time the score falls outside it
+constexpr int ASPIRATION_WINDOW = 40;
+/// History score worth one less ply of reduction
+constexpr int LMR_HISTORY_DIVISOR = 4096;
+
+/// Late move reductions grow with both the depth left and how late the move was ordered
+struct LmrTable {
+    int reductions[MAX_PLY][MAX_MOVES];
+    LmrTable() {
+        for (int depth = 0; depth < MAX_PLY; ++depth) {
+            for (int index = 0; index < MAX_MOVES; ++index) {
+                reductions[depth][index] = depth && index ? int(0.75 + std::log(depth) * std::log(index) / 2.25) : 0;
+            }
+        }
+    }
+};
+const LmrTable lmr_table;
 
-Agent::Agent(Chessboard initial_board) {
-    initialize_piece_structure_bonus();  // set all values of the piece structure vectors
-    root = new Node(initial_board, std::pair<int, int>{0, 0});
-
-    int pawn_value = 100;
-    int knight_value = 310;
-    int bishop_value = 320;
-    int rook_value = 500;
-    int queen_value = 900;
-    int king_value = 1500;
-    piece_values = {pawn_value, knight_value, bishop_value, rook_value, king_value, queen_value};
+int lmr_reduction(int depth, int index) {
+    return lmr_table.reductions[std::min(depth, MAX_PLY - 1)][std::min(index, MAX_MOVES - 1)];
 }
 
-void Agent::initialize_piece_structure_bonus() {
-    piece_structures.push_back(pawn_structure_black = {
-                                   0, 0, 0, 0, 0, 0, 0, 0,
-                                   5, 10, 10, -20, -20, 10, 10, 5,
-                                   5, -5, -10, 0, 0, -10, -5, 5,
-                                   0, 0, 0, 30, 30, 0, 0, 0,
-                                   5, 5, 10, 25, 25, 10, 5, 5,
-                                   10, 10, 20, 30, 30, 20, 10, 10,
-                                   50, 50, 50, 50, 50, 50, 50, 50,
-                                   0, 0, 0, 0, 0, 0, 0, 0});
-
-    piece_structures.push_back(knight_structure_black = {
-                                   -50, -40, -30, -30, -30, -30, -40, -50,
-                                   -40, -20, 0, 5, 5, 0, -20, -40,
-                                   -30, 5, 10, 15, 15, 10, 5, -30,
-                                   -30, 0, 15, 20, 20, 15, 0, -30,
-                                   -30, 5, 15, 20, 20, 15, 5, -30,
-                                   -30, 0, 10, 15, 15, 10, 0, -30,
-                                   -40, -20, 0, 0, 0, 0, -20, -40,
-                                   -50, -40, -30, -30, -30, -30, -40, -50});
-
-    piece_structures.push_back(bishop_structure_black = {
-                                   0, 0, 0, 5, 5, 0, 0, 0,
-                                   -5, 0, 0, 0, 0, 0, 0, -5,
-                                   -5, 0, 0, 0, 0, 0, 0, -5,
-                                   -5, 0, 0, 0, 0, 0, 0, -5,
-                                   -5, 0, 0, 0, 0, 0, 0, -5,
-                                   -5, 0, 0, 0, 0, 0, 0, -5,
-                                   5, 10, 10, 10, 10, 10, 10, 5,
-                                   0, 0, 0, 0, 0, 0, 0, 0});
-
-    piece_structures.push_back(rook_structure_black = {
-                                   0, 0, 0, 5, 5, 0, 0, 0,
-                                   -5, 0, 0, 0, 0, 0, 0, -5,
-                                   -5, 0, 0, 0, 0, 0, 0, -5,
-                                   -5, 0, 0, 0, 0, 0, 0, -5,
-                                   -5, 0, 0, 0, 0, 0, 0, -5,
-                                   -5, 0, 0, 0, 0, 0, 0, -5,
-                                   5, 10, 10, 10, 10, 10, 10, 5,
-                                   0, 0, 0, 0, 0, 0, 0, 0});
-
-    piece_structures.push_back(king_structure_black = {
-                                   20, 30, 10, 0, 0, 10, 30, 20,
-                                   20, 20, 0, 0, 0, 0, 20, 20,
-                                   -10, -20, -20, -20, -20, -20, -20, -10,
-                                   -20, -30, -30, -40, -40, -30, -30, -20,
-                                   -30, -40, -40, -50, -50, -40, -40, -30,
-                                   -30, -40, -40, -50, -50, -40, -40, -30,
-                                   -30, -40, -40, -50, -50, -40, -40, -30,
-                                   -30, -40, -40, -50, -50, -40, -40, -30});
-
-    piece_structures.push_back(end_king_structure_black = {
-                                   -50, -30, -30, -30, -30, -30, -30, -50,
-                                   -30, -30, 0, 0, 0, 0, -30, -30,
-                                   -30, -10, 20, 30, 30, 20, -10, -30,
-                                   -30, -10, 30, 40, 40, 30, -10, -30,
-                                   -30, -10, 30, 40, 40, 30, -10, -30,
-                                   -30, -10, 20, 30, 30, 20, -10, -30,
-                                   -30, -20, -10, 0, 0, -10, -20, -30,
-                                   -50, -40, -30, -20, -20, -30, -40, -50});
-
-    piece_structures.push_back(queen_structure_black = {
-                                   -20, -10, -10, -5, -5, -10, -10, -20,
-                                   -10, 0, 5, 0, 0, 0, 0, -10,
-                                   -10, 5, 5, 5, 5, 5, 0, -10,
-                                   0, 0, 5, 5, 5, 5, 0, -5,
-                                   -5, 0, 5, 5, 5, 5, 0, -5,
-                                   -10, 0, 5, 5, 5, 5, 0, -10,
-                                   -10, 0, 0, 0, 0, 0, 0, -10,
-                                   -20, -10, -10, -5, -5, -10, -10, -20});
-
-    piece_structures.push_back(pawn_structure_white = {
-                                   0, 0, 0, 0, 0, 0, 0, 0,
-                                   50, 50, 50, 50, 50, 50, 50, 50,
-                                   10, 10, 20, 30, 30, 20, 10, 10,
-                                   5, 5, 10, 25, 25, 10, 5, 5,
-                                   0, 0, 0, 20, 20, 0, 0, 0,
-                                   5, -5, -10, 0, 0, -10, -5, 5,
-                                   5, 10, 10, -20, -20, 10, 10, 5,
-                                   0, 0, 0, 0, 0, 0, 0, 0});
-
-    piece_structures.push_back(knight_structure_white = {
-                                   -50, -40, -30, -30, -30, -30, -40, -50,
-                                   -40, -20, 0, 0, 0, 0, -20, -40,
-                                   -30, 0, 10, 15, 15, 10, 0, -30,
-                                   -30, 5, 15, 20, 20, 15, 5, -30,
-                                   -30, 0, 15, 20, 20, 15, 0, -30,
-                                   -30, 5, 10, 15, 15, 10, 5, -30,
-                                   -40, -20, 0, 5, 5, 0, -20, -40,
-                                   -50, -40, -30, -30, -30, -30, -40, -50});
-
-    piece_structures.push_back(bishop_structure_white = {
-                                   0, 0, 0, 0, 0, 0, 0, 0,
-                                   5, 10, 10, 10, 10, 10, 10, 5,
-                                   -5, 0, 0, 0, 0, 0, 0, -5,
-                                   -5, 0, 0, 0, 0, 0, 0, -5,
-                                   -5, 0, 0, 0, 0, 0, 0, -5,
-                                   -5, 0, 0, 0, 0, 0, 0, -5,
-                                   -5, 0, 0, 0, 0, 0, 0, -5,
-                                   0, 0, 0, 5, 5, 0, 0, 0});
-
-    piece_structures.push_back(rook_structure_white = {
-                                   0, 0, 0, 0, 0, 0, 0, 0,
-                                   5, 10, 10, 10, 10, 10, 10, 5,
-                                   -5, 0, 0, 0, 0, 0, 0, -5,
-                                   -5, 0, 0, 0, 0, 0, 0, -5,
-                                   -5, 0, 0, 0, 0, 0, 0, -5,
-                                   -5, 0, 0, 0, 0, 0, 0, -5,
-                                   -5, 0, 0, 0, 0, 0, 0, -5,
-                                   0, 0, 0, 5, 5, 0, 0, 0});
-
-    piece_structures.push_back(king_structure_white = {
-                                   -30, -40, -40, -50, -50, -40, -40, -30,
-                                   -30, -40, -40, -50, -50, -40, -40, -30,
-                                   -30, -40, -40, -50, -50, -40, -40, -30,
-                                   -30, -40, -40, -50, -50, -40, -40, -30,
-                                   -20, -30, -30, -40, -40, -30, -30, -20,
-                                   -10, -20, -20, -20, -20, -20, -20, -10,
-                                   20, 20, 0, 0, 0, 0, 20, 20,
-                                   20, 30, 10, 0, 0, 10, 30, 20});
-
-    piece_structures.push_back(end_king_structure_white = {
-                                   -50, -40, -30, -20, -20, -30, -40, -50,
-                                   -30, -20, -10, 0, 0, -10, -20, -30,
-                                   -30, -10, 20, 30, 30, 20, -10, -30,
-                                   -30, -10, 30, 40, 40, 30, -10, -30,
-                                   -30, -10, 30, 40, 40, 30, -10, -30,
-                                   -30, -10, 20, 30, 30, 20, -10, -30,
-                                   -30, -30, 0, 0, 0, 0, -30, -30,
-                                   -50, -30, -30, -30, -30, -30, -30, -50});
-
-    piece_structures.push_back(queen_structure_white = {
-                                   -20, -10, -10, -5, -5, -10, -10, -20,
-                                   -10, 0, 0, 0, 0, 0, 0, -10,
-                                   -10, 0, 5, 5, 5, 5, 0, -10,
-                                   -5, 0, 5, 5, 5, 5, 0, -5,
-                                   0, 0, 5, 5, 5, 5, 0, -5,
-                                   -10, 5, 5, 5, 5, 5, 0, -10,
-                                   -10, 0, 5, 0, 0, 0, 0, -10,
-                                   -20, -10, -10, -5, -5, -10, -10, -20});
+/// Depth skewing for Lazy SMP helpers: helper i skips depths in runs of SKIP_SIZE[i], offset by SKIP_PHASE[i], so the threads spread out over different depths
+constexpr int SKIP_SIZE[20] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+constexpr int SKIP_PHASE[20] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+bool skip_depth(int helper_index, int depth) {
+    int i = (helper_index - 1) % 20;
+    return ((depth + SKIP_PHASE[i]) / SKIP_SIZE[i]) % 2;
 }
+}  // namespace
+
+Agent::Agent(Chessboard initial_board)
+    : owned_tt{new TranspositionTable()},
+      owned_eval_cache{new EvalCache()},
+      tt{*owned_tt},
+      eval_cache{*owned_eval_cache},
+      board{initial_board} {
+    board.history.reserve(board.history.size() + MAX_PLY);  // a copied vector loses its capacity, reserve it again like set_board()
+}
+
+Agent::Agent(const Chessboard &initial_board, TranspositionTable &shared_tt, EvalCache &shared_eval_cache, int helper_index)
+    : tt{shared_tt},
+      eval_cache{shared_eval_cache},
+      helper_index{helper_index},
+      board{initial_board} {}
 
-int Agent::minimax(Node *node, int depth, int alpha, int beta, bool maximizingPlayer) {
+Agent::~Agent() = default;
+
+int Agent::negamax(int depth, int ply, int alpha, int beta, bool null_allowed) {
     // recursively traverse the tree of moves calculating the score for each,
-    // then returning either the best or worst score depending on whose move it is
-    if (depth == 0) {
-        return evaluate(node->board_state);
-    }
-
-    if (maximizingPlayer) {
-        int maxEval = INT_MIN;
-        for (Node *child : node->children) {
-            int eval = minimax(child, depth - 1, alpha, beta, false);
-            maxEval = max(maxEval, eval);
-            alpha = max(alpha, eval);
-            if (beta <= alpha) {
-                break;  // Beta cutoff
+    // the best score for the team to move is the negation of the best score for the other team one ply down
+    check_limits();
+    if (stopped) {
+        return 0;
+    }
+    // with few enough pieces left the tables know the result of perfect play, scored like a mate found by searching
+    TbProbe tb_probe;
+    if (tablebase && board.w_num_pieces + board.b_num_pieces <= tablebase->max_pieces() && tablebase->probe(board, tb_probe)) {
+        ++tb_hits;
+        int mate_score = mate_in(ply, tb_probe.plies);
+        return tb_probe.result == TB_WIN ? mate_score : tb_probe.result == TB_LOSS ? -mate_score : 0;
+    }
+    if (depth <= 0) {
+        return options.quiescence ? quiescence(ply, alpha, beta) : evaluate_for_side_to_move();
+    }
+    if (ply >= MAX_PLY - 1) {
+        return evaluate_for_side_to_move();
+    }
+
+    // a zero window node only has to answer "better than alpha or not", a wider window is searching for the exact score
+    bool pv_node = beta - alpha > 1;
+    int alpha_orig = alpha;
+    TTEntry entry;
+    Move tt_move;
+    if (tt.probe(board.key, entry)) {
+        if (!pv_node && entry.depth >= depth) {
+            int tt_score = score_from_tt(entry.score, ply);
+            if (entry.bound == BOUND_EXACT ||
+                (entry.bound == BOUND_LOWER && tt_score >= beta) ||
+                (entry.bound == BOUND_UPPER && tt_score <= alpha)) {
+                return tt_score;
+            }
+        }
+        tt_move = entry.move;
+    }
+
+    bool in_check = board.is_check();
+    int static_eval = in_check ? -INFINITE_SCORE : evaluate_for_side_to_move();
+    bool mate_window = alpha <= -MATE_BOUND || beta >= MATE_BOUND;  // pruning on the static evaluation would hide mates
+
+    // Reverse futility: so far above beta that one quiet move from the other team won't bring it back
+    if (options.reverse_futility && !pv_node && !in_check && !mate_window && depth <= 3 &&
+        static_eval - FUTILITY_MARGIN * depth >= beta) {
+        return static_eval;
+    }
+
+    // Null move: if passing the turn still fails high at reduced depth, a real move will too.
+    // Not in check (passing would be illegal) and not with only pawns left, where zugzwang makes passing better than any move
+    if (options.null_move && null_allowed && !pv_node && !in_check && !mate_window && depth >= 3 && static_eval >= beta &&
+        has_non_pawn_material(board.white_to_move)) {
+        int reduction = 2 + depth / 6;
+        make_null_move();
+        int score = -negamax(depth - 1 - reduction, ply + 1, -beta, -beta + 1, false);
+        unmake_null_move();
+        if (stopped) {
+            return 0;
+        }
+        if (score >= beta) {
+            return score >= MATE_BOUND ? beta : score;  // a mate found after passing isn't a real mate
+        }
+    }
+
+    MoveList moves = generate_possible_moves();  // generated only now, a cutoff never pays for them
+    if (moves.empty()) {
+        return score_no_moves(ply);
+    }
+    int scores[MAX_MOVES];
+    score_moves(moves, tt_move, ply, scores);
+
+    // Futility: near the leaves a quiet move can't make up a large gap to alpha
+    bool futile = options.futility && !pv_node && !in_check && !mate_window && depth <= 2 &&
+                  static_eval + FUTILITY_MARGIN * depth <= alpha;
+
+    Move best_move;
+    int best_eval = -INFINITE_SCORE;
+    int moves_searched = 0;
+    for (int i = 0; i < moves.size(); ++i) {
+        Move move = MoveOrder::pick_move(moves, scores, i);
+        bool quiet = MoveOrder::is_quiet(board, move);
+        int history = move_order.history_score(board, move);
+        make_move(move);
+        bool gives_check = board.is_check();
+        if (futile && quiet && !gives_check && moves_searched > 0) {
+            unmake_move();
+            continue;
+        }
+
+        int eval;
+        if (moves_searched == 0) {
+            eval = -negamax(depth - 1, ply + 1, -beta, -alpha, true);
+        } else {
+            int reduction = 0;
+            if (options.lmr && depth >= 3 && moves_searched >= 3 && quiet && !in_check && !gives_check) {
+                reduction = lmr_reduction(depth, moves_searched) - history / LMR_HISTORY_DIVISOR;
+                reduction = std::clamp(reduction, 0, depth - 2);
+            }
+            if (options.pvs) {
+                eval = -negamax(depth - 1 - reduction, ply + 1, -alpha - 1, -alpha, true);
+                if (eval > alpha && reduction) {  // the reduced search beat alpha, check it at full depth
+                    eval = -negamax(depth - 1, ply + 1, -alpha - 1, -alpha, true);
+                }
+                if (eval > alpha && eval < beta) {  // better than the first move, find its exact score
+                    eval = -negamax(depth - 1, ply + 1, -beta, -alpha, true);
+                }
+            } else {
+                eval = -negamax(depth - 1 - reduction, ply + 1, -beta, -alpha, true);
+                if (eval > alpha && reduction) {
+                    eval = -negamax(depth - 1, ply + 1, -beta, -alpha, true);
+                }
+            }
+        }
+        unmake_move();
+        if (stopped) {  // the result is incomplete, don't let it into the table
+            return 0;
+        }
+        ++moves_searched;
+
+        if (eval > best_eval) {
+            best_eval = eval;
+            best_move = move;
+            if (eval > alpha) {
+                alpha = eval;
+            }
+        }
+        if (alpha >= beta) {
+            if (quiet) {
+                move_order.update_quiet_cutoff(board, move, ply, depth);
             }
+            break;  // Beta cutoff
+        }
+    }
+
+    Bound bound = best_eval <= alpha_orig ? BOUND_UPPER : best_eval >= beta ? BOUND_LOWER : BOUND_EXACT;
+    tt.store(board.key, depth, bound, score_to_tt(best_eval, ply), best_move);
+    return best_eval;
+}
+
+int Agent::quiescence(int ply, int alpha, int beta) {
+    check_limits();
+    if (stopped) {
+        return 0;
+    }
+    bool in_check = board.is_check();
+    if (ply >= MAX_PLY - 1) {
+        return evaluate_for_side_to_move();
+    }
+
+    // Standing pat: the evaluation is a lower bound on the score, as the team to move doesn't have to capture
+    int stand_pat = 0;
+    int best_eval = -INFINITE_SCORE;
+    if (!in_check) {
+        stand_pat = evaluate_for_side_to_move();
+        best_eval = stand_pat;
+        if (stand_pat >= beta) {
+            return stand_pat;
+        }
+        alpha = max(alpha, stand_pat);
+    }
+
+    MoveList moves;
+    if (in_check) {
+        generate_legal_moves(board, moves);  // every evasion, not only captures
+        if (moves.empty()) {
+            return score_no_moves(ply);
         }
-        return maxEval;
     } else {
-        int minEval = INT_MAX;
-        for (Node *child : node->children) {
-            int eval = minimax(child, depth - 1, alpha, beta, true);
-            minEval = min(minEval, eval);
-            beta = min(beta, eval);
-            if (beta <= alpha) {
-                break;  // Alpha cutoff
+        generate_legal_captures(board, moves);
+    }
+    int scores[MAX_MOVES];
+    move_order.score_moves(board, moves, Move(), ply, scores);  // always MVV-LVA here, the captures are all there is to sort
+
+    for (int i = 0; i < moves.size(); ++i) {
+        Move move = MoveOrder::pick_move(moves, scores, i);
+        if (!in_check) {
+            // Delta pruning: even winning the captured piece (and a margin) for free can't reach alpha
+            int gain = move.flag() == EN_PASSANT ? SEE_VALUES[PAWN] : board.is_empty(move.end()) ? 0 : SEE_VALUES[type_of(board.piece_on(move.end()))];
+            if (move.flag() == PROMOTION) {
+                gain += SEE_VALUES[move.promotion()] - SEE_VALUES[PAWN];
+            }
+            if (stand_pat + gain + DELTA_MARGIN <= alpha) {
+                continue;
+            }
+            if (static_exchange(board, move) < 0) {  // loses material once the recaptures are played out
+                continue;
             }
         }
-        return minEval;
+        make_move(move);
+        int eval = -quiescence(ply + 1, -beta, -alpha);
+        unmake_move();
+        best_eval = max(best_eval, eval);
+        alpha = max(alpha, eval);
+        if (alpha >= beta) {
+            break;
+        }
+    }
+    return best_eval;
+}
+
+int Agent::evaluate_for_side_to_move() {
+    int score;
+    if (options.eval_cache && eval_cache.probe(board.key, score)) {
+        ++eval_cache_hits;
+    } else {
+        if (network) {
+            // a network's bias can put its score anywhere, keep it short of a mate and inside the EvalCache's 16 bits
+            score = std::clamp(network->evaluate(accumulators[accumulator_index], board.white_to_move), -(MATE_BOUND - 1), MATE_BOUND - 1);
+        } else {
+            score = board.white_to_move ? -evaluate(board) : evaluate(board);  // evaluate() scores from black's point of view
+        }
+        if (options.eval_cache) {
+            ++eval_cache_misses;
+            eval_cache.store(board.key, score);
+        }
+    }
+    return score;
+}
+
+bool Agent::has_non_pawn_material(bool team_white) const {
+    return board.pieces(team_white) & ~(board.type_bb[PAWN] | board.type_bb[KING]);
+}
+
+int Agent::score_no_moves(int ply) {
+    if (!board.is_check()) {
+        return 0;  // stalemate
+    }
+    return -(MATE_SCORE - ply);  // the team to move is mated, sooner mates are worth more to the winner
+}
+
+void Agent::score_moves(const MoveList &moves, Move tt_move, int ply, int *scores) {
+    if (options.move_ordering) {
+        move_order.score_moves(board, moves, tt_move, ply, scores);
+        return;
+    }
+    for (int i = 0; i < moves.size(); ++i) {
+        scores[i] = moves[i] == tt_move;
+    }
+}
+
+void Agent::order_first(MoveList &moves, Move move) {
+    for (int i = 1; i < moves.size(); ++i) {
+        if (moves[i] == move) {
+            std::swap(moves[0], moves[i]);
+            return;
+        }
     }
 }
 
@@ -200,117 +328,281 @@ int Agent::min(int a, int b) { return (a < b) ? a : b; }
 
 int Agent::max(int a, int b) { return (a > b) ? a : b; }
 
-std::pair<int, int> Agent::find_best_move(int depth) {
-    // Generate the tree of game states up to the specified depth
-    bool b_team = true;
-    generate_tree(root, depth, b_team);
+Move Agent::find_best_move(int depth) {
+    SearchLimits depth_only;
+    depth_only.depth = depth;
+    return search(depth_only).best_move;
+}
 
-    int best_score = INT_MIN;
-    std::pair<int, int> best_move;
+SearchResult Agent::search(const SearchLimits &search_limits) {
+    limits = search_limits;
+    start_time = std::chrono::steady_clock::now();
+    stop_requested = false;
+    time_budget_ms = limits.movetime_ms;
+    if (!time_budget_ms && limits.time_left_ms) {
+        // plan for about 25 more moves, and never use more than half the clock on one
+        time_budget_ms = std::min(limits.time_left_ms / 25 + limits.increment_ms / 2, limits.time_left_ms / 2);
+        time_budget_ms = std::max<int64_t>(time_budget_ms, 1);
+    }
+    tt.new_search();
+
+    // helpers only stop when told to, this thread watches the limits for all of them
+    std::vector<std::thread> workers;
+    for (std::unique_ptr<Agent> &helper : helpers) {
+        helper->set_board(board);
+        helper->options = options;
+        helper->tablebase = tablebase;
+        helper->limits = SearchLimits{};
+        helper->limits.depth = limits.depth;
+        helper->time_budget_ms = 0;
+        helper->stop_requested = false;
+        workers.emplace_back([&helper]() { helper->iterative_deepening(); });
+    }
 
-    int alpha = INT_MIN;
-    int beta = INT_MAX;
+    SearchResult result = iterative_deepening();
 
-    // Use minimax to find the best move
-    for (Node *child : root->children) {
-        int score = minimax(child, depth - 1, alpha, beta, false);
-        if (score > best_score && root->board_state.is_valid_move(child->move.first, child->move.second)) {
-            best_score = score;
-            best_move = child->move;
-        }
+    for (size_t i = 0; i < helpers.size(); ++i) {
+        helpers[i]->stop();
+        workers[i].join();
+        result.nodes += helpers[i]->nodes;
+        result.eval_cache_hits += helpers[i]->eval_cache_hits;
+        result.eval_cache_misses += helpers[i]->eval_cache_misses;
+        result.tb_hits += helpers[i]->tb_hits;
     }
-    return best_move;  // best move can't be the same position twice, that
-                       // causes a bug that makes pieces disappear
+    result.time_ms = elapsed_ms();
+    return result;
 }
 
-void Agent::generate_tree(Node *node, int depth, bool b_team) {
-    if (depth == 0) {
-        return;
+void Agent::set_threads(int count) {
+    helpers.clear();
+    for (int i = 1; i < count; ++i) {
+        helpers.emplace_back(new Agent(board, tt, eval_cache, i));
+        helpers.back()->adopt_network(network);
+    }
+}
+
+SearchResult Agent::iterative_deepening() {
+    nodes = 0;
+    eval_cache_hits = eval_cache_misses = 0;
+    tb_hits = 0;
+    stopped = false;
+    can_stop = helper_index > 0;  // a helper's result is never used, so it may stop at any time
+    move_order.new_search();
+    accumulator_index = 0;
+    if (network) {
+        network->refresh(board, accumulators[0]);
     }
-    std::vector<std::pair<int, int>> possible_moves = generate_possible_moves(node, b_team);
-    for (std::pair<int, int> move : possible_moves) {
-        if (node->board_state.is_valid_move(move.first, move.second)) {
-            Chessboard nextState = node->board_state;  // make copy for the next child
-            if (nextState.move_piece(move.first, move.second)) {
-                // if the move was valid
-                Node *child = new Node(nextState, move);
-                generate_tree(child, depth - 1, !b_team);
-                node->children.push_back(child);
+    MoveList moves = generate_possible_moves();
+    SearchResult result;
+    if (moves.empty()) {
+        return result;
+    }
+
+    // sort the root moves once, later iterations move their best move to the front
+    TTEntry entry;
+    int scores[MAX_MOVES];
+    score_moves(moves, tt.probe(board.key, entry) ? entry.move : Move(), 0, scores);
+    for (int i = 0; i < moves.size(); ++i) {
+        MoveOrder::pick_move(moves, scores, i);
+    }
+
+    for (int depth = 1; depth <= limits.depth; ++depth) {
+        if (helper_index && skip_depth(helper_index, depth)) {
+            continue;
+        }
+        uint64_t nodes_before = nodes;
+        int alpha = -INFINITE_SCORE;
+        int beta = INFINITE_SCORE;
+        int window = ASPIRATION_WINDOW;
+        if (options.aspiration && depth >= 4 && std::abs(result.score) < MATE_BOUND) {
+            alpha = result.score - window;
+            beta = result.score + window;
+        }
+
+        Move best_move;
+        int score;
+        while (true) {
+            Move window_best;
+            score = search_root(moves, depth, alpha, beta, window_best);
+            if (stopped) {
+                break;
             }
+            if (score <= alpha) {  // failed low, every move may be worse than thought, widen downwards
+                alpha = std::max(score - window, -INFINITE_SCORE);
+            } else if (score >= beta) {  // failed high, the move that did it is at least this good
+                best_move = window_best;
+                beta = std::min(score + window, int(INFINITE_SCORE));
+            } else {
+                best_move = window_best;
+                break;
+            }
+            window *= 2;
+        }
+        if (stopped) {
+            break;  // this iteration didn't finish, keep the last one that did
+        }
+        result.branching_factor = std::pow(double(nodes - nodes_before), 1.0 / depth);
+        result.best_move = best_move;
+        result.score = score;
+        result.depth = depth;
+        order_first(moves, best_move);  // the previous iteration's best move is searched first
+        can_stop = true;
+
+        // a new iteration takes several times longer than the last, don't start one that can't finish
+        if (time_budget_ms && elapsed_ms() * 2 > time_budget_ms) {
+            break;
+        }
+        if (std::abs(score) >= MATE_BOUND) {
+            break;  // a forced mate was found, searching deeper can't change it
         }
     }
+    result.nodes = nodes;
+    result.eval_cache_hits = eval_cache_hits;
+    result.eval_cache_misses = eval_cache_misses;
+    result.tb_hits = tb_hits;
+    return result;
 }
 
-std::vector<std::pair<int, int>> Agent::generate_possible_moves(Node *node, bool b_team) {
-    std::vector<std::pair<int, int>> all_possible_moves;
-    for (Tile tile : node->board_state.chessboard) {
-        std::vector<int> possible_moves;
-        if (b_team) {
-            if (tile.has_piece() && !tile.piece->team_white) {
-                possible_moves =
-                    tile.piece->get_possible_moves(node->board_state);
-            }
+int Agent::search_root(MoveList &moves, int depth, int alpha, int beta, Move &best_move) {
+    int alpha_orig = alpha;
+    int best_score = -INFINITE_SCORE;
+    for (int i = 0; i < moves.size(); ++i) {  // already legal, no need to test each one
+        Move move = moves[i];
+        make_move(move);
+        int score;
+        if (i == 0 || !options.pvs) {
+            score = -negamax(depth - 1, 1, -beta, -alpha, true);
         } else {
-            if (tile.has_piece() && tile.piece->team_white) {
-                possible_moves =
-                    tile.piece->get_possible_moves(node->board_state);
+            score = -negamax(depth - 1, 1, -alpha - 1, -alpha, true);
+            if (score > alpha && score < beta) {
+                score = -negamax(depth - 1, 1, -beta, -alpha, true);
+            }
+        }
+        unmake_move();
+        if (stopped) {
+            return 0;
+        }
+        if (score > best_score) {
+            best_score = score;
+            if (score > alpha) {
+                best_move = move;
+                alpha = score;
             }
         }
-        for (int i : possible_moves) {
-            all_possible_moves.push_back({tile.piece->pos, i});
+        if (alpha >= beta) {
+            break;
         }
     }
-    return all_possible_moves;
+    Bound bound = best_score <= alpha_orig ? BOUND_UPPER : best_score >= beta ? BOUND_LOWER : BOUND_EXACT;
+    tt.store(board.key, depth, bound, score_to_tt(best_score, 0), best_move);
+    return best_score;
+}
+
+void Agent::stop() {
+    stop_requested = true;
 }
 
-int Agent::evaluate(Chessboard state) {
-    // calculates a given game state based on all piece values, the mobility of said pieces, and the structure of their formation
-    if (state.w_num_pieces < 5) {
-        king_structure_white = end_king_structure_white;
+void Agent::check_limits() {
+    if (stopped) {
+        return;
+    }
+    ++nodes;
+    if (!can_stop) {
+        return;
     }
-    if (state.b_num_pieces < 5) {
-        king_structure_black = end_king_structure_black;
+    if (stop_requested.load(std::memory_order_relaxed) || (limits.nodes && nodes >= limits.nodes)) {
+        stopped = true;
+    } else if (time_budget_ms && (nodes & 1023) == 0 && elapsed_ms() >= time_budget_ms) {  // reading the clock is slow, only look every 1024 nodes
+        stopped = true;
     }
-    int score = 0;
+}
 
-    for (auto &tile : state.chessboard) {
-        if (tile.piece) {
-            int pieceValue = get_piece_value(tile.piece->type);  // Piece values
-            score += (tile.piece->team_white ? -pieceValue : pieceValue);
+int64_t Agent::elapsed_ms() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
 
-            std::vector<int> possibleMoves = tile.piece->get_possible_moves(state);  // Mobility
-            score += possibleMoves.size() * (tile.piece->team_white ? -1 : 1);
+MoveList Agent::generate_possible_moves() {
+    return board.get_legal_moves();
+}
 
-            if (tile.piece->team_white) {  // Piece structure
-                score -= get_piece_structure(tile.piece.value()).at(tile.piece->pos);
-            } else {
-                score += get_piece_structure(tile.piece.value()).at(tile.piece->pos);
+int Agent::evaluate(const Chessboard &state) {
+    // material and piece structure are kept up to date by the board as moves are made and the pawn structure is cached by pawn_table,
+    // only the rooks' columns and mobility are counted here
+    const PawnEntry &pawns = pawn_table.probe(state);
+    PsqScore psq = state.psq + pawns.score;
+    for (bool team_white : {false, true}) {
+        Bitboard rooks = state.pieces(team_white, ROOK);
+        PsqScore rook_files{};
+        while (rooks) {
+            int col = col_of(pop_lsb(rooks));
+            if (pawns.open_files & (1 << col)) {
+                rook_files += ROOK_OPEN_FILE_BONUS;
+            } else if (pawns.semi_open_files[team_white] & (1 << col)) {
+                rook_files += ROOK_SEMI_OPEN_FILE_BONUS;
             }
         }
+        psq += team_white ? -rook_files : rook_files;
+    }
+    int score = taper(psq, state.game_phase());
+
+    Bitboard occupied = state.occupied();
+    while (occupied) {
+        int pos = pop_lsb(occupied);
+        uint8_t piece = state.piece_on(pos);
+        int mobility = popcount(Piece{pos, type_of(piece), is_white(piece)}.get_possible_moves_bb(state));
+        score += is_white(piece) ? -mobility : mobility;
     }
 
     return score;
 }
-std::vector<int> Agent::get_piece_structure(Piece piece) {  // piece structure constant time lookup
-    return piece_structures.at(piece.type + piece.team_white * 6);
+
+void Agent::set_network(std::shared_ptr<const NnueNetwork> new_network) {
+    adopt_network(new_network);
+    for (std::unique_ptr<Agent> &helper : helpers) {
+        helper->adopt_network(new_network);
+    }
+    eval_cache.clear();  // the cached scores came from the old evaluation
 }
 
-int Agent::get_piece_value(Type type) {
-    return piece_values.at(type);
+void Agent::adopt_network(std::shared_ptr<const NnueNetwork> new_network) {
+    network = std::move(new_network);
+    accumulators.resize(network ? MAX_PLY + 1 : 0);  // sized up front, so the search never allocates
 }
 
-void Agent::reset_tree(Chessboard state) {
-    root->reset_tree_recursive();
+void Agent::make_move(Move move) {
+    if (!network) {
+        board.make_move(move);
+        return;
+    }
+    NnueDirty dirty = nnue_dirty(board, move);
+    board.make_move(move);
+    network->update(accumulators[accumulator_index], accumulators[accumulator_index + 1], board, dirty);
+    ++accumulator_index;
+}
 
-    root = new Node(state, std::pair<int, int>());
+void Agent::unmake_move() {
+    board.unmake_move();
+    if (network) {
+        --accumulator_index;
+    }
 }
 
-void Node::reset_tree_recursive() {
-    for (auto &child : children) {
-        if (!child) {
-            return;
-        }
-        child->reset_tree_recursive();
+void Agent::make_null_move() {
+    board.make_null_move();
+    if (network) {
+        accumulators[accumulator_index + 1] = accumulators[accumulator_index];
+        ++accumulator_index;
+    }
+}
+
+void Agent::unmake_null_move() {
+    board.unmake_null_move();
+    if (network) {
+        --accumulator_index;
     }
-    delete this;
-}
\ No newline at end of file
+}
+
+void Agent::set_board(const Chessboard &state) {
+    board = state;
+    board.history.reserve(board.history.size() + MAX_PLY);  // so making moves during the search never reallocates
+}
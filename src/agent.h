@@ -2,88 +2,201 @@
  * @file agent.h
  * @brief How the Agent finds its move.
  *
- * The agent files are used to produce the best move for the black team. Finding the best move requires looking at how a move affects mobility, structuring of pieces, and whether or not you take or lose pieces. This is all calculated in the function evaluate(). This function is called on every move that the minimax algorithm (with alpha beta pruning) passes it. The minimax algorithm is used to allow the agent to search X moves ahead and figure out which produces the best possible outcome for itself, and the worst possible outcome for the other player. Each move/new gamestate is represented within a Node, and each Node hold a vector of other Nodes.
+ * The agent files are used to produce the best move for the black team. Finding the best move requires looking at how a move affects mobility, structuring of pieces, and whether or not you take or lose pieces. This is all calculated in the function evaluate(). This function is called on every move that the minimax algorithm (with alpha beta pruning) passes it. The minimax algorithm is used to allow the agent to search X moves ahead and figure out which produces the best possible outcome for itself, and the worst possible outcome for the other player. The search is depth first: each position's moves are generated into a MoveList on the stack only when the search reaches it, so an alpha beta cutoff skips generating the rest of that branch, and memory use grows with the depth rather than the size of the tree. The Agent keeps a single Chessboard and walks it up and down the search with make_move() and unmake_move(). Every searched position's result is stored in a TranspositionTable, so a position reached again through another move order can reuse it instead of being searched from scratch.
  *
  */
 /*  */
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 #include "chessboard.h"
+#include "eval_cache.h"
+#include "move_order.h"
+#include "nnue.h"
+#include "pawn_table.h"
+#include "tablebase.h"
+#include "transposition_table.h"
 
-/// The Node structure is what makes up the tree of game states/moves traversed within Agent
-class Node {
-   public:
-    Node(Chessboard state, std::pair<int, int> move) : board_state(state), move(move), score(0) {}
-    /// clears out the tree created for the previous move's game state recursively
-    void reset_tree_recursive();
+/// @brief When a search has to stop, any limit left at 0 is ignored
+struct SearchLimits {
+    /// Deepest iteration to search
+    int depth = MAX_PLY - 1;
+    /// Exact time to spend on the move
+    int64_t movetime_ms = 0;
+    /// Time left on the clock of the team to move, the search spends a share of it
+    int64_t time_left_ms = 0;
+    /// Time added to the clock after each move
+    int64_t increment_ms = 0;
+    /// Stop after searching this many positions
+    uint64_t nodes = 0;
+};
 
-    Chessboard board_state;
-    std::pair<int, int> move;
-    int score;
-    std::vector<Node *> children;
+/// @brief Outcome of the deepest iteration that finished
+struct SearchResult {
+    Move best_move;
+    /// From the point of view of the team to move
+    int score = 0;
+    int depth = 0;
+    /// Positions searched by every iteration, finished or not
+    uint64_t nodes = 0;
+    int64_t time_ms = 0;
+    /// Effective branching factor of the last finished iteration: the number b where b^depth is the positions it searched
+    double branching_factor = 0;
+    /// Static evaluations found in the EvalCache and evaluated from scratch, by every thread
+    uint64_t eval_cache_hits = 0;
+    uint64_t eval_cache_misses = 0;
+    /// Positions the Tablebase knew the result of, by every thread
+    uint64_t tb_hits = 0;
+};
 
-   private:
-    Node(Node &&other) = delete;
-    Node &operator=(Node &&other) = delete;
+/// @brief Search techniques that can be switched off, to measure what each one is worth
+struct SearchOptions {
+    /// Order moves by MVV-LVA, killers and history; when off only the TranspositionTable move is tried first
+    bool move_ordering = true;
+    /// Keep searching captures past the last ply instead of evaluating in the middle of an exchange
+    bool quiescence = true;
+    /// Principal variation search: every move after the first is searched with a zero window, and only re-searched if it turns out better
+    bool pvs = true;
+    /// Search each iteration in a narrow window around the previous iteration's score, widening it if the score falls outside
+    bool aspiration = true;
+    /// Skip a turn and search shallower; if the position is still good enough for a cutoff, prune it
+    bool null_move = true;
+    /// Late move reductions: search quiet moves ordered late less deeply, re-searching them if they beat alpha
+    bool lmr = true;
+    /// Skip quiet moves near the leaves when the static evaluation is far below alpha
+    bool futility = true;
+    /// Return the static evaluation near the leaves when it is far above beta
+    bool reverse_futility = true;
+    /// Look static evaluations up in the EvalCache before evaluating
+    bool eval_cache = true;
 };
 
 /// Class used to programmatically produce a Chess move
 class Agent {
    public:
     Agent(Chessboard initial_board);
-    Node *root;
-    std::pair<int, int> find_best_move(int depth);
+    ~Agent();
+    /// Searches to exactly depth and returns the best move for the team to move
+    Move find_best_move(int depth);
+    /**
+     * @brief Iterative deepening search within limits.
+     *
+     * Searches depth 1, 2, 3 and so on, trying the best move of the previous iteration first, until an iteration reaches limits.depth or the time or node budget runs out. An iteration that is cut short is thrown away, so the result is always the best move of the deepest iteration that finished. Depth 1 is always finished so there is a move to play.
+     *
+     * With more than one thread (see set_threads()) this is a Lazy SMP search: every helper thread runs the same iterative deepening on its own copy of the board, with its own killers and history, sharing only the TranspositionTable. Helpers skip some depths so they spread out over different iterations, and what they store lets the calling thread cut off and order its own search sooner. The calling thread alone watches the limits, stops the helpers and returns the result; the node limit counts only its own nodes.
+     */
+    SearchResult search(const SearchLimits &limits);
+    /// Asks a running search() to stop as soon as possible, safe to call from another thread
+    void stop();
+    /// Number of threads search() uses, the calling thread included
+    void set_threads(int count);
+    int threads() const { return int(helpers.size()) + 1; }
 
-    /// Calls the recursive function inside Node
-    void reset_tree(Chessboard state);
+   private:
+    /// Only the TranspositionTable and EvalCache of the Agent that starts the search are used, helpers borrow them
+    std::unique_ptr<TranspositionTable> owned_tt;
+    std::unique_ptr<EvalCache> owned_eval_cache;
+
+   public:
+    /// Results of earlier searches, kept between moves since many positions come up again, shared by every thread
+    TranspositionTable &tt;
+    /// Static evaluations, kept between moves and shared by every thread like tt
+    EvalCache &eval_cache;
+    SearchOptions options;
+    /// Pawn structure scores, one table per thread, hits() and misses() count this Agent's probes only
+    PawnTable pawn_table;
+
+    /// Replaces the game state the next search starts from
+    void set_board(const Chessboard &state);
+    /// Evaluates with network (see nnue.h) instead of evaluate(), nullptr goes back to evaluate(), clears eval_cache
+    void set_network(std::shared_ptr<const NnueNetwork> network);
+    /// Endgame tables the search looks positions with few enough pieces up in instead of searching them, may be nullptr
+    std::shared_ptr<const Tablebase> tablebase;
+
+    /// Calculates a given game state's 'score' based on all piece values, the mobility of said pieces, and the structure of their formation, from black's point of view
+    int evaluate(const Chessboard &state);
 
    private:
-    void initialize_piece_structure_bonus();
-    std::vector<std::pair<int, int>> generate_possible_moves(Node *node, bool b_team);
+    /// Helper for a Lazy SMP search, searching with shared_tt
+    Agent(const Chessboard &initial_board, TranspositionTable &shared_tt, EvalCache &shared_eval_cache, int helper_index);
+    /// Iterative deepening shared by the calling thread and the helpers, see search()
+    SearchResult iterative_deepening();
 
-    /// Constructs the tree where each layer is one move ahead of the current state
-    void generate_tree(Node *node, int depth, bool b_team);
-    /// Recursively traverse tree of game states with a possible move applied, calling evaluate() on each move
-    int minimax(Node *node, int depth, int alpha, int beta, bool maximizingPlayer);
-    int min(int a, int b);
-    int max(int a, int b);
+    /// Agents searching alongside this one on their own threads
+    std::vector<std::unique_ptr<Agent>> helpers;
+    /// 0 for the Agent search() is called on, 1 and up for its helpers
+    int helper_index = 0;
+    /// Legal moves for the team whose turn it is on board
+    MoveList generate_possible_moves();
 
-    /// Calculates a given game state's 'score' based on all piece values, the mobility of said pieces, and the structure of their formation
-    int evaluate(Chessboard state);
+    /// Game state the search starts from, moves are made and unmade on it while searching
+    Chessboard board;
 
-    /// Constant time lookup for what structure to use
-    std::vector<int> get_piece_structure(Piece piece);
-    int get_piece_value(Type type);
+    /// Limits of the search() in progress
+    SearchLimits limits;
+    std::chrono::steady_clock::time_point start_time;
+    /// Time the search aims to use, 0 for no time limit
+    int64_t time_budget_ms;
+    uint64_t nodes = 0;
+    uint64_t eval_cache_hits;
+    uint64_t eval_cache_misses;
+    uint64_t tb_hits;
+    /// Set once a limit is reached, every search function then returns straight away without storing anything
+    bool stopped;
+    /// Set by stop() from any thread
+    std::atomic<bool> stop_requested{false};
+    /// Iterations deep enough that the search may be stopped, depth 1 always finishes
+    bool can_stop;
+    /// Killers and history learned while searching
+    MoveOrder move_order;
 
-    /// vector of piece values ordered to allow constant time lookups
-    std::vector<int> piece_values;
+    /// Network evaluating positions instead of evaluate(), shared by every thread, may be nullptr
+    std::shared_ptr<const NnueNetwork> network;
+    /// accumulators[i] is for the board accumulator_index moves into the search, only used with a network
+    std::vector<NnueAccumulator> accumulators;
+    int accumulator_index;
+    /// Sets network and sizes accumulators for it, without touching eval_cache
+    void adopt_network(std::shared_ptr<const NnueNetwork> new_network);
+    /// Make and unmake moves on board, keeping the network's accumulators up to date
+    void make_move(Move move);
+    void unmake_move();
+    void make_null_move();
+    void unmake_null_move();
+
+    /// Sets stopped if a limit has been reached, called every node
+    void check_limits();
+    int64_t elapsed_ms() const;
+    /// Searches every root move to depth in the window (alpha, beta), returns the best score for the team to move and sets best_move if one beat alpha
+    int search_root(MoveList &moves, int depth, int alpha, int beta, Move &best_move);
 
     /**
-     * @brief vector of piece structures ordered to allow constant time lookups
+     * @brief Recursively searches every move depth moves ahead, generating each position's moves as it is reached.
      *
-     * piece structures are used for scoring a game state based on the position of pieces given a game state
+     * Scores are negamax style, from the point of view of the team to move, so each ply negates and swaps the window of the one below it. ply is the distance from the root, used to score quicker mates higher. null_allowed is false right after a null move, so two are never made in a row.
      */
-    std::vector<std::vector<int>> piece_structures;
-    std::vector<int> pawn_structure_white;
-    std::vector<int> pawn_structure_black;
-    std::vector<int> knight_structure_white;
-    std::vector<int> knight_structure_black;
-    std::vector<int> bishop_structure_white;
-    std::vector<int> bishop_structure_black;
-    std::vector<int> rook_structure_white;
-    std::vector<int> rook_structure_black;
-    std::vector<int> king_structure_white;
-    std::vector<int> king_structure_black;
-    std::vector<int> queen_structure_white;
-    std::vector<int> queen_structure_black;
-
+    int negamax(int depth, int ply, int alpha, int beta, bool null_allowed);
     /**
-     * @brief end game king structures
+     * @brief Searches only captures and promotions until the position is quiet, called where negamax() runs out of depth.
      *
-     * End game king structures are used to help promote the agent in making better decisions with its king or against the enemy king late game. More points for keeping king centered, less for the king being near the edges making checks/mates easier
+     * The team to move may "stand pat" on evaluate() instead of capturing, since it is never forced to capture. Captures that can't raise the score to alpha even if the captured piece came for free (delta pruning) and captures that lose material in a static exchange are skipped. In check every legal move is searched, as standing pat isn't allowed.
      */
-    std::vector<int> end_king_structure_white;
-    std::vector<int> end_king_structure_black;
+    int quiescence(int ply, int alpha, int beta);
+    /// The network's or evaluate()'s score from the point of view of the team to move, looked up in eval_cache first
+    int evaluate_for_side_to_move();
+    /// False when the team has only pawns and its king, where null move pruning is unsafe because of zugzwang
+    bool has_non_pawn_material(bool team_white) const;
+    /// Score of a position with no legal moves for the team to move: mate is scored by how many plies away it is, stalemate is a draw
+    int score_no_moves(int ply);
+    /// Moves move to the front of moves so it is searched first
+    void order_first(MoveList &moves, Move move);
+    /// Scores moves with move_order, or only puts tt_move first when options.move_ordering is off
+    void score_moves(const MoveList &moves, Move tt_move, int ply, int *scores);
+    int min(int a, int b);
+    int max(int a, int b);
 
     Agent(const Agent &other) = delete;
     Agent &operator=(const Agent &other) = delete;
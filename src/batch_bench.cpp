@@ -0,0 +1,74 @@
+/**
+ * @file batch_bench.cpp
+ * @brief Measures positions per second of evaluate_batch() with each kernel and over several threads.
+ *
+ * Collects every position a few moves deep from the starting position, packs them, and scores the whole set a number of times: first with the scalar kernel, then with AVX2 if the CPU has it, both on one thread, then with the best kernel split over every hardware thread. Each run's scores are checked against the scalar ones.
+ *
+ * Usage: batch_bench [depth] [repeats]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "batch_eval.h"
+#include "chessboard.h"
+
+namespace {
+void collect(Chessboard &board, std::vector<PackedPosition> &positions, int depth) {
+    positions.push_back(pack_position(board));
+    if (depth == 0) {
+        return;
+    }
+    for (Move move : board.get_legal_moves()) {
+        board.make_move(move);
+        collect(board, positions, depth - 1);
+        board.unmake_move();
+    }
+}
+
+template <typename F>
+void run(const std::string &name, size_t count, int repeats, F evaluate) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; ++i) {
+        evaluate();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << name << ": " << count * repeats << " positions in " << int(seconds * 1000) << " ms, "
+              << int(count * repeats / seconds) << " positions/s\n";
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+    int depth = argc > 1 ? std::atoi(argv[1]) : 4;
+    int repeats = argc > 2 ? std::atoi(argv[2]) : 10;
+
+    Chessboard board;
+    std::vector<PackedPosition> positions;
+    collect(board, positions, depth);
+    size_t count = positions.size();
+
+    std::vector<int> expected(count);
+    std::vector<int> scores(count);
+    run("scalar, 1 thread", count, repeats, [&] { evaluate_batch(positions.data(), count, expected.data(), SIMD_SCALAR); });
+
+    if (best_simd_level() >= SIMD_AVX2) {
+        run("avx2, 1 thread", count, repeats, [&] { evaluate_batch(positions.data(), count, scores.data(), SIMD_AVX2); });
+        if (scores != expected) {
+            std::cout << "avx2 scores differ from scalar\n";
+            return 1;
+        }
+    }
+
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    std::fill(scores.begin(), scores.end(), 0);
+    run(std::string(simd_level_name(best_simd_level())) + ", " + std::to_string(threads) + " threads", count, repeats,
+        [&] { evaluate_batch_parallel(positions.data(), count, scores.data(), threads); });
+    if (scores != expected) {
+        std::cout << "parallel scores differ from scalar\n";
+        return 1;
+    }
+}
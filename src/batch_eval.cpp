@@ -0,0 +1,126 @@
+/**
+ * @file batch_eval.cpp
+ * @brief Scores large sets of positions at once, for analysis and tuning outside of a search.
+ *
+ * Both kernels read the same flat tables, indexed by piece code * 64 + tile with a row of zeros for NO_PIECE, so an empty tile needs no branch. The AVX2 kernel tapers with single precision floats: every product of a score and a phase is far below 2^24, so the float division truncates to exactly the integer division the scalar code does.
+ */
+#include "batch_eval.h"
+
+#include <thread>
+#include <vector>
+
+#ifdef CHESS_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+/// Number of positions the AVX2 kernel scores at once, one per 32 bit lane
+constexpr int BLOCK = 8;
+
+/// @brief PSQ_TABLE and PHASE_WEIGHTS flattened to piece code * 64 + tile, NO_PIECE included
+struct FlatTables {
+    int32_t mg[13 * 64];
+    int32_t eg[13 * 64];
+    int32_t phase[13 * 64];
+};
+
+constexpr FlatTables make_flat_tables() {
+    FlatTables tables{};
+    for (int piece = 0; piece < 12; ++piece) {
+        for (int pos = 0; pos < 64; ++pos) {
+            tables.mg[piece * 64 + pos] = PSQ_TABLE.scores[piece][pos].mg;
+            tables.eg[piece * 64 + pos] = PSQ_TABLE.scores[piece][pos].eg;
+            tables.phase[piece * 64 + pos] = PHASE_WEIGHTS[piece % 6];
+        }
+    }
+    return tables;
+}
+
+alignas(64) constexpr FlatTables TABLES = make_flat_tables();
+
+int piece_at(const PackedPosition &position, int pos) {
+    return (position.tiles[pos / 2] >> (4 * (pos % 2))) & 15;
+}
+
+int evaluate_scalar(const PackedPosition &position) {
+    PsqScore score{};
+    int phase = 0;
+    for (int pos = 0; pos < 64; ++pos) {
+        int index = piece_at(position, pos) * 64 + pos;
+        score += PsqScore{TABLES.mg[index], TABLES.eg[index]};
+        phase += TABLES.phase[index];
+    }
+    return taper(score, phase < MAX_PHASE ? phase : MAX_PHASE);
+}
+
+#ifdef CHESS_SIMD_X86
+__attribute__((target("avx2"))) void evaluate_block_avx2(const PackedPosition *positions, int *scores) {
+    // structure of arrays: indices[pos] holds the table index of tile pos in each of the eight positions
+    alignas(32) int32_t indices[64][BLOCK];
+    for (int lane = 0; lane < BLOCK; ++lane) {
+        for (int byte = 0; byte < 32; ++byte) {
+            uint8_t tiles = positions[lane].tiles[byte];
+            indices[2 * byte][lane] = (tiles & 15) * 64 + 2 * byte;
+            indices[2 * byte + 1][lane] = (tiles >> 4) * 64 + 2 * byte + 1;
+        }
+    }
+
+    __m256i mg = _mm256_setzero_si256();
+    __m256i eg = _mm256_setzero_si256();
+    __m256i phase = _mm256_setzero_si256();
+    for (int pos = 0; pos < 64; ++pos) {
+        __m256i index = _mm256_load_si256(reinterpret_cast<const __m256i *>(indices[pos]));
+        mg = _mm256_add_epi32(mg, _mm256_i32gather_epi32(TABLES.mg, index, 4));
+        eg = _mm256_add_epi32(eg, _mm256_i32gather_epi32(TABLES.eg, index, 4));
+        phase = _mm256_add_epi32(phase, _mm256_i32gather_epi32(TABLES.phase, index, 4));
+    }
+    phase = _mm256_min_epi32(phase, _mm256_set1_epi32(MAX_PHASE));
+
+    // (mg * phase + eg * (MAX_PHASE - phase)) / MAX_PHASE, truncated towards zero like the scalar code
+    __m256i blended = _mm256_add_epi32(_mm256_mullo_epi32(mg, phase),
+                                       _mm256_mullo_epi32(eg, _mm256_sub_epi32(_mm256_set1_epi32(MAX_PHASE), phase)));
+    __m256 quotient = _mm256_div_ps(_mm256_cvtepi32_ps(blended), _mm256_set1_ps(float(MAX_PHASE)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(scores), _mm256_cvttps_epi32(quotient));
+}
+#endif
+}  // namespace
+
+PackedPosition pack_position(const Position &position) {
+    PackedPosition packed;
+    for (int byte = 0; byte < 32; ++byte) {
+        packed.tiles[byte] = uint8_t(position.mailbox[2 * byte] | position.mailbox[2 * byte + 1] << 4);
+    }
+    return packed;
+}
+
+void evaluate_batch(const PackedPosition *positions, size_t count, int *scores, SimdLevel level) {
+    size_t i = 0;
+#ifdef CHESS_SIMD_X86
+    if (level >= SIMD_AVX2 && best_simd_level() >= SIMD_AVX2) {
+        for (; i + BLOCK <= count; i += BLOCK) {
+            evaluate_block_avx2(positions + i, scores + i);
+        }
+    }
+#endif
+    for (; i < count; ++i) {  // whatever doesn't fill a block, or everything without AVX2
+        scores[i] = evaluate_scalar(positions[i]);
+    }
+}
+
+void evaluate_batch_parallel(const PackedPosition *positions, size_t count, int *scores, int threads, SimdLevel level) {
+    if (threads < 1) {
+        threads = 1;
+    }
+    // whole blocks per thread so only the last part has a scalar remainder
+    size_t part = (count / threads + BLOCK - 1) / BLOCK * BLOCK;
+    std::vector<std::thread> workers;
+    size_t start = 0;
+    for (int t = 1; t < threads && start + part < count; ++t) {
+        workers.emplace_back(evaluate_batch, positions + start, part, scores + start, level);
+        start += part;
+    }
+    evaluate_batch(positions + start, count - start, scores + start, level);
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
@@ -0,0 +1,29 @@
+/**
+ * @file batch_eval.h
+ * @brief Scores large sets of positions at once, for analysis and tuning outside of a search.
+ *
+ * A PackedPosition stores a game state's pieces in 32 bytes, so millions of them fit in memory and stream through the CPU cache quickly. evaluate_batch() gives each one the material and piece-square score of psqt.h, tapered by game phase exactly as Agent::evaluate() does it (taper(Position::psq, Position::game_phase())), without building a Chessboard or an Agent.
+ *
+ * The AVX2 kernel scores eight positions at a time. It unpacks them into a structure of arrays, one row of eight piece codes per tile, and then for every tile gathers the middle game, end game and phase values for all eight positions with one instruction each and adds them up across lanes. There is no gather before AVX2, so the SSE4.1 level uses the scalar code. evaluate_batch_parallel() splits a batch between threads.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "position.h"
+#include "simd.h"
+
+/// @brief The pieces of a game state packed into 32 bytes
+struct PackedPosition {
+    /// Two tiles per byte, the lower board index in the low nibble, each holding its piece code or NO_PIECE
+    uint8_t tiles[32];
+};
+
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition must stay 32 bytes");
+
+PackedPosition pack_position(const Position &position);
+
+/// Material and piece-square score of each of count positions into scores, from black's point of view like Agent::evaluate()
+void evaluate_batch(const PackedPosition *positions, size_t count, int *scores, SimdLevel level = best_simd_level());
+/// evaluate_batch() split into equal parts over threads threads, the calling thread included
+void evaluate_batch_parallel(const PackedPosition *positions, size_t count, int *scores, int threads, SimdLevel level = best_simd_level());
@@ -0,0 +1,30 @@
+/**
+ * @file bench.h
+ * @brief Searches a fixed set of positions to a fixed depth, giving a node count that changes whenever the search does.
+ *
+ * The bench positions are 40 games in progress: openings, middlegames full of captures and checks, endgames down to a few pieces, and a position with no legal moves at all. run_bench() searches each of them to a fixed depth on one thread, with the same depth only search() that Agent::find_best_move() runs, from an empty TranspositionTable, EvalCache and PawnTable, and without endgame tables, so the total number of nodes is the same on every machine and every run. It only changes when the move generator, evaluate() or the search visit different positions, which makes it a signature of the engine's behaviour: a change meant only to be faster must leave it as it was, and a change to the search should update it on purpose. The time taken gives the speed, to compare builds and hosts.
+ *
+ * `uci bench [depth] [signature]` runs it from the command line, and exits with 1 if the total differs from the signature given.
+ */
+#pragma once
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+
+#include "agent.h"
+
+/// Depth `uci bench` searches to when none is given
+constexpr int BENCH_DEPTH = 8;
+
+/// FEN records of the positions run_bench() searches, in the order it searches them
+extern const std::array<const char *, 40> BENCH_POSITIONS;
+
+/// @brief Totals of a run_bench()
+struct BenchResult {
+    /// Sum of the nodes searched for every position, the same on every run at the same depth
+    uint64_t nodes = 0;
+    int64_t time_ms = 0;
+};
+
+/// Searches every bench position to depth on one thread, writing the best move, score (for the team to move) and nodes of each to log if it isn't nullptr
+BenchResult run_bench(int depth, std::ostream *log = nullptr);
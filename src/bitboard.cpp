@@ -0,0 +1,150 @@
+/**
+ * @file bitboard.cpp
+ * @brief 64 bit sets of board indices and the attack tables built on them.
+ *
+ * The rook and bishop attack tables are filled here once at startup. For every tile, each subset of the tiles that could block the slider is enumerated and its attack set is found by walking the rays. With BMI2 available the subset's PEXT index is used directly; otherwise a magic number is searched for that maps every subset to a slot without harmful collisions.
+ */
+#include "bitboard.h"
+
+Magic rook_magics[64];
+Magic bishop_magics[64];
+bool use_pext = false;
+Bitboard between_table[64][64];
+Bitboard line_table[64][64];
+
+namespace {
+const int rook_directions[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+const int bishop_directions[4][2] = {{-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+
+/// Shared storage for every tile's attack sets, sized for the largest masks (12 rook bits, 9 bishop bits)
+Bitboard rook_table[0x19000];
+Bitboard bishop_table[0x1480];
+
+Bitboard ray_attacks(int pos, Bitboard occupied, const int (*directions)[2]) {
+    Bitboard attacks = EMPTY_BB;
+    for (int i = 0; i < 4; ++i) {
+        int row = row_of(pos) + directions[i][0];
+        int col = col_of(pos) + directions[i][1];
+        while (row >= 0 && row < 8 && col >= 0 && col < 8) {
+            attacks |= square_bb(row * 8 + col);
+            if (occupied & square_bb(row * 8 + col)) {  // blocked, the blocker itself is still attacked
+                break;
+            }
+            row += directions[i][0];
+            col += directions[i][1];
+        }
+    }
+    return attacks;
+}
+
+/// Per row seeds that find working magics in few attempts, so startup stays fast on CPUs without BMI2
+const uint64_t MAGIC_SEEDS[8] = {728, 10316, 55013, 32803, 2009, 15100, 16645, 255};
+
+/// xorshift64* generator, seeded so the same magics are found on every run
+class Random {
+   public:
+    explicit Random(uint64_t seed) : state{seed} {}
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 2685821657736338717ULL;
+    }
+    /// Magics with few set bits are found much faster
+    uint64_t sparse() { return next() & next() & next(); }
+
+   private:
+    uint64_t state;
+};
+
+bool cpu_has_bmi2() {
+#if defined(__GNUC__) && defined(__x86_64__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("bmi2");
+#else
+    return false;
+#endif
+}
+
+void init_magics(Magic *magics, Bitboard *table, Bitboard (*slow_attacks)(int, Bitboard)) {
+    static Bitboard occupancy[4096];
+    static Bitboard reference[4096];
+    static int epoch[4096];
+    static int attempt = 0;  // epochs must keep increasing across calls, the slots are shared
+
+    for (int pos = 0; pos < 64; ++pos) {
+        Magic &m = magics[pos];
+        // tiles on the edge of the board never block anything further along the ray
+        Bitboard edges = ((ROW_0_BB | ROW_7_BB) & ~(ROW_0_BB << (8 * row_of(pos)))) |
+                         ((FILE_A_BB | FILE_H_BB) & ~(FILE_A_BB << col_of(pos)));
+        m.mask = slow_attacks(pos, EMPTY_BB) & ~edges;
+        m.shift = 64 - popcount(m.mask);
+        m.attacks = pos == 0 ? table : magics[pos - 1].attacks + (1 << (64 - magics[pos - 1].shift));
+
+        // walk every subset of the mask (Carry-Rippler trick) and record its attacks
+        int size = 0;
+        Bitboard subset = EMPTY_BB;
+        do {
+            occupancy[size] = subset;
+            reference[size] = slow_attacks(pos, subset);
+            if (use_pext) {
+                m.attacks[pext(subset, m.mask)] = reference[size];
+            }
+            ++size;
+            subset = (subset - m.mask) & m.mask;
+        } while (subset);
+
+        if (use_pext) {
+            continue;
+        }
+
+        // try random magics until one maps every subset to a slot holding the same attacks
+        Random random{MAGIC_SEEDS[row_of(pos)]};
+        for (int i = 0; i < size;) {
+            m.magic = EMPTY_BB;
+            while (popcount((m.magic * m.mask) >> 56) < 6) {
+                m.magic = random.sparse();
+            }
+            ++attempt;
+            for (i = 0; i < size; ++i) {
+                unsigned index = m.index(occupancy[i]);
+                if (epoch[index] < attempt) {
+                    epoch[index] = attempt;
+                    m.attacks[index] = reference[i];
+                } else if (m.attacks[index] != reference[i]) {
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/// Fills the tables before main() runs so every Chessboard can rely on them
+const bool bitboards_initialized = (init_bitboards(), true);
+}  // namespace
+
+void init_bitboards(bool allow_pext) {
+    use_pext = allow_pext && cpu_has_bmi2();
+    init_magics(rook_magics, rook_table, rook_attacks_slow);
+    init_magics(bishop_magics, bishop_table, bishop_attacks_slow);
+
+    for (int a = 0; a < 64; ++a) {
+        for (int b = 0; b < 64; ++b) {
+            between_table[a][b] = line_table[a][b] = EMPTY_BB;
+            for (auto slow_attacks : {rook_attacks_slow, bishop_attacks_slow}) {
+                if (a != b && (slow_attacks(a, EMPTY_BB) & square_bb(b))) {
+                    line_table[a][b] = (slow_attacks(a, EMPTY_BB) & slow_attacks(b, EMPTY_BB)) | square_bb(a) | square_bb(b);
+                    between_table[a][b] = slow_attacks(a, square_bb(b)) & slow_attacks(b, square_bb(a));
+                }
+            }
+        }
+    }
+}
+
+Bitboard rook_attacks_slow(int pos, Bitboard occupied) {
+    return ray_attacks(pos, occupied, rook_directions);
+}
+
+Bitboard bishop_attacks_slow(int pos, Bitboard occupied) {
+    return ray_attacks(pos, occupied, bishop_directions);
+}
@@ -0,0 +1,140 @@
+/**
+ * @file bitboard.h
+ * @brief 64 bit sets of board indices and the attack tables built on them.
+ *
+ * A Bitboard stores one bit per Tile, where bit i is set if board index i is in the set. Board indices follow the rest of the engine: 0 is the top left corner (black's back rank) and 63 is the bottom right corner (white's back rank), so moving "up" the board for white subtracts 8 from an index. Sets of pieces, attacked tiles and possible moves can all be stored this way and combined with single bitwise instructions instead of loops over the board.
+ *
+ * Knight, king and pawn attacks never depend on other pieces, so they are generated at compile time into constant tables. Rook and bishop attacks depend on which tiles block their rays; for those, the relevant blockers are hashed into a table index with a "magic" multiply and shift (see https://www.chessprogramming.org/Magic_Bitboards), or with the PEXT instruction on CPUs that have BMI2. The choice is made once at startup, and either way a slider's attack set is a single table load.
+ */
+#pragma once
+#include <array>
+#include <cstdint>
+
+/// One bit per board index, bit 0 is index 0
+using Bitboard = uint64_t;
+
+constexpr Bitboard EMPTY_BB = 0;
+constexpr Bitboard FILE_A_BB = 0x0101010101010101ULL;
+constexpr Bitboard FILE_H_BB = FILE_A_BB << 7;
+/// Top row of the board (black's back rank)
+constexpr Bitboard ROW_0_BB = 0xFFULL;
+/// Bottom row of the board (white's back rank)
+constexpr Bitboard ROW_7_BB = ROW_0_BB << 56;
+
+constexpr Bitboard square_bb(int pos) { return 1ULL << pos; }
+constexpr int row_of(int pos) { return pos / 8; }
+constexpr int col_of(int pos) { return pos % 8; }
+
+inline int popcount(Bitboard b) { return __builtin_popcountll(b); }
+/// Index of the least significant set bit, b must not be empty
+inline int lsb(Bitboard b) { return __builtin_ctzll(b); }
+/// Index of the most significant set bit, b must not be empty
+inline int msb(Bitboard b) { return 63 - __builtin_clzll(b); }
+/// Removes and returns the least significant set bit, b must not be empty
+inline int pop_lsb(Bitboard &b) {
+    int pos = lsb(b);
+    b &= b - 1;
+    return pos;
+}
+
+/// Tiles reached from pos by each (row, col) offset that stays on the board
+template <int N>
+constexpr Bitboard offset_attacks(int pos, const int (&offsets)[N][2]) {
+    Bitboard attacks = EMPTY_BB;
+    for (int i = 0; i < N; ++i) {
+        int row = row_of(pos) + offsets[i][0];
+        int col = col_of(pos) + offsets[i][1];
+        if (row >= 0 && row < 8 && col >= 0 && col < 8) {
+            attacks |= square_bb(row * 8 + col);
+        }
+    }
+    return attacks;
+}
+
+constexpr int KNIGHT_OFFSETS[8][2] = {{-2, -1}, {-2, 1}, {-1, -2}, {-1, 2}, {1, -2}, {1, 2}, {2, -1}, {2, 1}};
+constexpr int KING_OFFSETS[8][2] = {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}};
+/// White pawns attack up the board, black pawns down
+constexpr int PAWN_OFFSETS[2][2][2] = {{{1, -1}, {1, 1}}, {{-1, -1}, {-1, 1}}};
+
+template <int N>
+constexpr std::array<Bitboard, 64> make_offset_table(const int (&offsets)[N][2]) {
+    std::array<Bitboard, 64> table{};
+    for (int pos = 0; pos < 64; ++pos) {
+        table[pos] = offset_attacks(pos, offsets);
+    }
+    return table;
+}
+
+inline constexpr std::array<Bitboard, 64> KNIGHT_ATTACKS = make_offset_table(KNIGHT_OFFSETS);
+inline constexpr std::array<Bitboard, 64> KING_ATTACKS = make_offset_table(KING_OFFSETS);
+/// Indexed by [team_white][pos]
+inline constexpr std::array<Bitboard, 64> PAWN_ATTACKS[2] = {make_offset_table(PAWN_OFFSETS[0]), make_offset_table(PAWN_OFFSETS[1])};
+
+/// @brief Everything needed to turn a slider's blockers into an index of its attack table
+struct Magic {
+    /// Tiles whose occupancy changes the attack set, board edges excluded
+    Bitboard mask;
+    Bitboard magic;
+    /// Start of this tile's slice of the shared attack table
+    Bitboard *attacks;
+    unsigned shift;
+
+    unsigned index(Bitboard occupied) const;
+};
+
+extern Magic rook_magics[64];
+extern Magic bishop_magics[64];
+/// Tiles strictly between two tiles sharing a row, column or diagonal, empty otherwise
+extern Bitboard between_table[64][64];
+/// Whole row, column or diagonal through two tiles (including both), empty if they don't share one
+extern Bitboard line_table[64][64];
+/// True when the attack tables are indexed with PEXT instead of magic multiplication
+extern bool use_pext;
+
+/**
+ * @brief Builds the rook and bishop attack tables and the between/line tables.
+ *
+ * Runs automatically before main(); call it again with allow_pext = false to force the magic multiplication path (used by tests to check both ways of indexing).
+ */
+void init_bitboards(bool allow_pext = true);
+
+/// Parallel bit extract of occupied under mask, only valid when use_pext is true
+inline Bitboard pext(Bitboard occupied, Bitboard mask) {
+#if defined(__GNUC__) && defined(__x86_64__)
+    Bitboard result;
+    // inline asm rather than the _pext_u64 intrinsic so the rest of the engine can be built for CPUs without BMI2
+    __asm__("pextq %2, %1, %0" : "=r"(result) : "r"(occupied), "r"(mask));
+    return result;
+#else
+    (void)occupied;
+    (void)mask;
+    return 0;
+#endif
+}
+
+inline unsigned Magic::index(Bitboard occupied) const {
+    if (use_pext) {
+        return unsigned(pext(occupied, mask));
+    }
+    return unsigned(((occupied & mask) * magic) >> shift);
+}
+
+inline Bitboard knight_attacks(int pos) { return KNIGHT_ATTACKS[pos]; }
+inline Bitboard king_attacks(int pos) { return KING_ATTACKS[pos]; }
+inline Bitboard pawn_attacks(int pos, bool team_white) { return PAWN_ATTACKS[team_white][pos]; }
+inline Bitboard rook_attacks(int pos, Bitboard occupied) {
+    const Magic &m = rook_magics[pos];
+    return m.attacks[m.index(occupied)];
+}
+inline Bitboard bishop_attacks(int pos, Bitboard occupied) {
+    const Magic &m = bishop_magics[pos];
+    return m.attacks[m.index(occupied)];
+}
+inline Bitboard queen_attacks(int pos, Bitboard occupied) { return rook_attacks(pos, occupied) | bishop_attacks(pos, occupied); }
+inline Bitboard between(int a, int b) { return between_table[a][b]; }
+inline Bitboard line(int a, int b) { return line_table[a][b]; }
+
+/// Tiles a rook on pos attacks, found by walking each ray until it hits a piece. Reference used to build the tables
+Bitboard rook_attacks_slow(int pos, Bitboard occupied);
+/// Tiles a bishop on pos attacks, found by walking each ray until it hits a piece. Reference used to build the tables
+Bitboard bishop_attacks_slow(int pos, Bitboard occupied);
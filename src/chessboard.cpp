@@ -3,197 +3,294 @@
  *
  * @brief Creates, stores, and makes changes to data for a game state.
  *
- * The chessboard files are used to create, store, and make changes to data for a game state. Each game state is comprised of Tiles, and each Tile is able to have a Piece. It also has member functions that handle possible moves calculated in the piece files. The Chessboard class also differentiates between pseudo-legal moves and legal moves. This is done inside the is_valid_move() for testing one Piece's moves, and also in the is_checkmate() function which finds all legal moves for a given side.
+ * The chessboard files are used to create, store, and make changes to data for a game state. The game state itself is a bitboard Position (see position.h), and a Tile holding a Piece can be built from any of its board indices for code that wants to look at one square at a time. It also has member functions that handle possible moves calculated in the piece files. The Chessboard class also differentiates between pseudo-legal moves and legal moves. This is done inside the is_valid_move() for testing one Piece's moves, and also in the is_checkmate() function which finds all legal moves for a given side.
  */
 #include "chessboard.h"
 
+#include <array>
+#include <cstdlib>
 #include <iostream>
 #include <string>
 
 #include "piece.h"
 
 Chessboard::Chessboard() {
+    white_to_move = true;
     fill_starting_tiles();
     selected_piece_index = -1;
-    white_to_move = true;
-}
-Chessboard::~Chessboard() {}
-
-Chessboard::Chessboard(const Chessboard &other)  // copy constructor
-    : chessboard{std::move(other.chessboard)},
-      selected_piece_index{other.selected_piece_index},
-      white_to_move{other.white_to_move},
-      w_king_index{other.w_king_index},
-      b_king_index{other.b_king_index},
-      w_num_pieces{other.w_num_pieces},
-      b_num_pieces{other.b_num_pieces} {}
-
-Chessboard &Chessboard::operator=(const Chessboard &other) {
-    chessboard = std::move(other.chessboard);
-    selected_piece_index = other.selected_piece_index;
-    white_to_move = other.white_to_move;
-    w_king_index = other.w_king_index;
-    b_king_index = other.b_king_index;
-    w_num_pieces = other.w_num_pieces;
-    b_num_pieces = other.b_num_pieces;
-    return *this;
+    history.reserve(256);  // deep enough that a search never reallocates
 }
 
-Chessboard::Chessboard(Chessboard &&other)  // move constructor
-    : chessboard{std::move(other.chessboard)},
-      selected_piece_index{other.selected_piece_index},
-      white_to_move{other.white_to_move},
-      w_king_index{other.w_king_index},
-      b_king_index{b_king_index},
-      w_num_pieces{other.w_num_pieces},
-      b_num_pieces{other.b_num_pieces} {
-    other.selected_piece_index = -1;
+Chessboard::Chessboard(std::string_view fen) : Chessboard() {
+    set_fen(fen);
 }
 
-Chessboard &Chessboard::operator=(Chessboard &&other) {  // move assignment operator
-    chessboard = std::move(other.chessboard);
-    selected_piece_index = other.selected_piece_index;
-    white_to_move = other.white_to_move;
-    b_king_index = other.b_king_index;
-    w_king_index = other.w_king_index;
-    w_num_pieces = other.w_num_pieces;
-    b_num_pieces = other.b_num_pieces;
-    return *this;
-}
-
-bool Chessboard::is_valid_move(int start, int end) {
-    if (in_bounds(start) && in_bounds(end)) {
-        std::vector<int> possible_moves = chessboard.at(start).piece->get_possible_moves(*this);
-        std::vector<std::pair<int, int>> pseudo_legal = reshape_vector(possible_moves, start);  // format to be a vector of pairs
-        std::vector<std::pair<int, int>> legal = get_all_legal_moves(pseudo_legal);
-        for (auto move : legal) {
-            if (end == move.second && in_bounds(move.second)) {
-                return true;
+namespace {
+/// Piece letters in Type order, upper case for white in FEN
+constexpr std::string_view PIECE_LETTERS = "pnbrkq";
+/// Castling right letters, each with the tiles its king and rook start on
+constexpr std::string_view CASTLING_LETTERS = "KQkq";
+constexpr uint8_t CASTLING_BITS[4] = {W_KING_SIDE, W_QUEEN_SIDE, B_KING_SIDE, B_QUEEN_SIDE};
+constexpr int CASTLING_KINGS[4] = {60, 60, 4, 4};
+constexpr int CASTLING_ROOKS[4] = {63, 56, 7, 0};
+
+bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+}  // namespace
+
+size_t Chessboard::set_fen(std::string_view text, bool move_counters) {
+    Position loaded;
+    loaded.clear_pieces();
+    size_t i = 0;
+    auto start_field = [&](const char *name) {
+        while (i < text.size() && is_space(text[i])) {
+            ++i;
+        }
+        if (i == text.size()) {
+            throw FenError(std::string("missing ") + name, i);
+        }
+    };
+    auto end_field = [&]() {
+        if (i < text.size() && !is_space(text[i])) {
+            throw FenError(std::string("unexpected '") + text[i] + "'", i);
+        }
+    };
+
+    start_field("piece placement");
+    int row = 0, col = 0;
+    for (; i < text.size() && !is_space(text[i]); ++i) {
+        char c = text[i];
+        if (c == '/') {
+            if (col != 8 || row == 7) {
+                throw FenError(row == 7 ? "more than 8 ranks" : "rank with fewer than 8 tiles", i);
+            }
+            ++row;
+            col = 0;
+        } else if (c >= '1' && c <= '8') {
+            col += c - '0';
+            if (col > 8) {
+                throw FenError("rank with more than 8 tiles", i);
+            }
+        } else {
+            size_t type = PIECE_LETTERS.find(char(c | 0x20));  // lower case
+            bool white = c >= 'A' && c <= 'Z';
+            if (type == std::string_view::npos) {
+                throw FenError(std::string("unknown piece '") + c + "'", i);
+            } else if (col == 8) {
+                throw FenError("rank with more than 8 tiles", i);
+            } else if (type == PAWN && (row == 0 || row == 7)) {
+                throw FenError("pawn on the first or last rank", i);
+            } else if (type == KING && loaded.king_index(white) >= 0) {
+                throw FenError("second king of one team", i);
             }
+            loaded.put_piece(row * 8 + col++, Type(type), white);
         }
     }
-    return false;
-}
+    if (row != 7 || col != 8) {
+        throw FenError("piece placement isn't 8 ranks of 8 tiles", i);
+    } else if (loaded.w_king_index < 0 || loaded.b_king_index < 0) {
+        throw FenError("a team has no king", i);
+    }
 
-bool Chessboard::is_check() {
-    if (!white_to_move) {
-        for (int i : attackable_by_white) {
-            if (i == b_king_index) {
-                return true;
+    start_field("team to move");
+    size_t team_offset = i;
+    if (text[i] != 'w' && text[i] != 'b') {
+        throw FenError("team to move isn't w or b", i);
+    }
+    loaded.white_to_move = text[i++] == 'w';
+    end_field();
+
+    start_field("castling rights");
+    if (text[i] == '-') {
+        ++i;
+    } else {
+        for (; i < text.size() && !is_space(text[i]); ++i) {
+            size_t right = CASTLING_LETTERS.find(text[i]);
+            if (right == std::string_view::npos) {
+                throw FenError(std::string("unknown castling right '") + text[i] + "'", i);
+            }
+            bool white = right < 2;
+            if (loaded.piece_on(CASTLING_KINGS[right]) == make_piece(KING, white) && loaded.piece_on(CASTLING_ROOKS[right]) == make_piece(ROOK, white)) {
+                loaded.castling_rights |= CASTLING_BITS[right];
             }
         }
+    }
+    end_field();
+
+    start_field("en passant tile");
+    if (text[i] == '-') {
+        ++i;
     } else {
-        for (int i : attackable_by_black) {
-            if (i == w_king_index) {
-                return true;
+        char rank = loaded.white_to_move ? '6' : '3';
+        if (text[i] < 'a' || text[i] > 'h' || i + 1 == text.size() || text[i + 1] != rank) {
+            throw FenError(std::string("en passant tile isn't on rank ") + rank, i);
+        }
+        int pos = ('8' - rank) * 8 + (text[i] - 'a');
+        if (pawn_attacks(pos, !loaded.white_to_move) & loaded.pieces(loaded.white_to_move, PAWN)) {
+            loaded.ep_index = int8_t(pos);
+        }
+        i += 2;
+    }
+    end_field();
+
+    if (move_counters) {
+        for (const char *name : {"halfmove clock", "fullmove number"}) {
+            while (i < text.size() && is_space(text[i])) {
+                ++i;
             }
+            if (i == text.size()) {
+                break;  // both are optional
+            } else if (text[i] < '0' || text[i] > '9') {
+                throw FenError(std::string(name) + " isn't a number", i);
+            }
+            while (i < text.size() && text[i] >= '0' && text[i] <= '9') {
+                ++i;
+            }
+            end_field();
+        }
+        size_t end = i;
+        while (end < text.size() && is_space(text[end])) {
+            ++end;
+        }
+        if (end != text.size()) {
+            throw FenError("unexpected text after the fullmove number", end);
         }
     }
-    return false;
-}
 
-bool Chessboard::is_checkmate() {
-    std::vector<std::pair<int, int>> pseudo_legal = get_all_pseudo_moves();
-    std::vector<std::pair<int, int>> legal_moves = get_all_legal_moves(pseudo_legal);
-    return legal_moves.empty();  // If no move could be found to prevent mate, then it is a mate
+    int other_king = loaded.king_index(!loaded.white_to_move);
+    if (attackers_to(loaded, other_king, loaded.occupied()) & loaded.pieces(loaded.white_to_move)) {
+        throw FenError("the team not to move is in check", team_offset);
+    }
+    loaded.key = loaded.compute_key();
+    static_cast<Position &>(*this) = loaded;
+    history.clear();
+    selected_piece_index = -1;
+    return i;
 }
 
-std::vector<std::pair<int, int>> Chessboard::get_all_pseudo_moves() {
-    // Get all pseudo-legal moves for the current player
-    std::vector<std::pair<int, int>> pseudo_legal;
-    for (Tile &t : chessboard) {
-        if (t.has_piece() && t.piece->team_white == white_to_move) {
-            std::vector<int> moves = t.piece->get_possible_moves(*this);
-            for (int move : moves) {
-                pseudo_legal.push_back({t.piece->pos, move});
+std::string Chessboard::fen(bool move_counters) const {
+    std::string text;
+    text.reserve(96);
+    for (int row = 0; row < 8; ++row) {
+        int empty = 0;
+        for (int col = 0; col < 8; ++col) {
+            uint8_t piece = piece_on(row * 8 + col);
+            if (piece == NO_PIECE) {
+                ++empty;
+                continue;
+            }
+            if (empty) {
+                text += char('0' + empty);
+                empty = 0;
             }
+            char letter = PIECE_LETTERS[type_of(piece)];
+            text += is_white(piece) ? char(letter - 0x20) : letter;  // upper case for white
+        }
+        if (empty) {
+            text += char('0' + empty);
+        }
+        if (row < 7) {
+            text += '/';
         }
     }
-    return pseudo_legal;
-}
-
-std::vector<std::pair<int, int>> Chessboard::get_all_legal_moves(std::vector<std::pair<int, int>> pseudo_legal) {
-    std::vector<std::pair<int, int>> legal;
-    // For each move, check if opponent's king is still in checkmate after the move
-    for (auto move : pseudo_legal) {
-        Chessboard temp_board(*this);
-        temp_board.move_piece_temp(move.first, move.second);  // Apply the move to a temporary board
-        if (!temp_board.is_check()) {                         // Check if the king is still in check
-            legal.push_back(move);                            // Move prevents checkmate, so save as legal move
+    text += white_to_move ? " w " : " b ";
+    if (!castling_rights) {
+        text += '-';
+    }
+    for (int right = 0; right < 4; ++right) {
+        if (castling_rights & CASTLING_BITS[right]) {
+            text += CASTLING_LETTERS[right];
         }
     }
-    return legal;
+    text += ' ';
+    if (ep_index >= 0) {
+        text += char('a' + ep_index % 8);
+        text += char('8' - ep_index / 8);
+    } else {
+        text += '-';
+    }
+    if (move_counters) {
+        text += " 0 1";
+    }
+    return text;
 }
 
-void Chessboard::recalculate_attackable_tiles() {
-    // clear out data that is being recalculated
-    attackable_by_black.clear();
-    attackable_by_white.clear();
-    w_num_pieces = 0;
-    b_num_pieces = 0;
-    for (Tile &t : chessboard) {
-        if (t.has_piece()) {
-            update_piece_counts(t);
-            std::vector<int> possible_moves = t.piece->get_possible_moves(*this);
-            if (t.piece->team_white) {
-                for (int i : possible_moves) {
-                    attackable_by_white.insert(i);
-                }
-            } else {
-                for (int i : possible_moves) {
-                    attackable_by_black.insert(i);
-                }
-            }
+bool Chessboard::is_valid_move(int start, int end) {
+    for (const Move &move : get_legal_moves()) {
+        if (move.start() == start && move.end() == end) {
+            return true;
         }
     }
+    return false;
 }
 
-void Chessboard::update_piece_counts(const Tile &t) {
-    if (t.piece->team_white) {
-        w_num_pieces++;
-    } else {
-        b_num_pieces++;
+bool Chessboard::is_check() {
+    int king = king_index(white_to_move);
+    return king != -1 && is_attacked(king, !white_to_move);
+}
+
+bool Chessboard::is_attacked(int pos, bool by_white) const {
+    Bitboard occupied_bb = occupied();
+    Bitboard queens = pieces(by_white, QUEEN);
+    return (pawn_attacks(pos, !by_white) & pieces(by_white, PAWN)) ||  // a pawn attacks pos if a pawn of the other team on pos would attack it
+           (knight_attacks(pos) & pieces(by_white, KNIGHT)) ||
+           (king_attacks(pos) & pieces(by_white, KING)) ||
+           (rook_attacks(pos, occupied_bb) & (pieces(by_white, ROOK) | queens)) ||
+           (bishop_attacks(pos, occupied_bb) & (pieces(by_white, BISHOP) | queens));
+}
+
+Tile Chessboard::tile(int pos) const {
+    if (pos < 0 || pos >= 64 || is_empty(pos)) {
+        return Tile{};
     }
+    return Tile{Piece{pos, type_of(piece_on(pos)), is_white(piece_on(pos))}};
+}
+
+bool Chessboard::is_checkmate() {
+    return get_legal_moves().empty();  // If no move could be found to prevent mate, then it is a mate
+}
+
+MoveList Chessboard::get_legal_moves() const {
+    MoveList moves;
+    generate_legal_moves(*this, moves);
+    return moves;
 }
 
 void Chessboard::fill_starting_tiles() {
+    clear_pieces();
     place_starting_b_pieces();
-    for (int i = 16; i < 48; ++i) {  // create tiles w/o pieces
-        chessboard.push_back(Tile{});
-    }
     place_starting_w_pieces();
+    castling_rights = ALL_CASTLING;
+    key = compute_key();
 }
 
 void Chessboard::place_starting_b_pieces() {
-    chessboard.push_back(Tile{Piece{0, ROOK, false}});
-    chessboard.push_back(Tile{Piece{1, KNIGHT, false}});
-    chessboard.push_back(Tile{Piece{2, BISHOP, false}});
-    chessboard.push_back(Tile{Piece{3, QUEEN, false}});
-    chessboard.push_back(Tile{Piece{4, KING, false}});
-    b_king_index = 4;
-    chessboard.push_back(Tile{Piece{5, BISHOP, false}});
-    chessboard.push_back(Tile{Piece{6, KNIGHT, false}});
-    chessboard.push_back(Tile{Piece{7, ROOK, false}});
+    put_piece(0, ROOK, false);
+    put_piece(1, KNIGHT, false);
+    put_piece(2, BISHOP, false);
+    put_piece(3, QUEEN, false);
+    put_piece(4, KING, false);
+    put_piece(5, BISHOP, false);
+    put_piece(6, KNIGHT, false);
+    put_piece(7, ROOK, false);
 
     for (int i = 8; i < 16; ++i) {
-        chessboard.push_back(Tile{Piece{i, PAWN, false}});
+        put_piece(i, PAWN, false);
     }
 }
 
 void Chessboard::place_starting_w_pieces() {
     for (int i = 48; i < 56; ++i) {
-        chessboard.push_back(Tile{Piece{i, PAWN, true}});
+        put_piece(i, PAWN, true);
     }
 
-    chessboard.push_back(Tile{Piece{56, ROOK, true}});
-    chessboard.push_back(Tile{Piece{57, KNIGHT, true}});
-    chessboard.push_back(Tile{Piece{58, BISHOP, true}});
-    chessboard.push_back(Tile{Piece{59, QUEEN, true}});
-    chessboard.push_back(Tile{Piece{60, KING, true}});
-    w_king_index = 60;
-    chessboard.push_back(Tile{Piece{61, BISHOP, true}});
-    chessboard.push_back(Tile{Piece{62, KNIGHT, true}});
-    chessboard.push_back(Tile{Piece{63, ROOK, true}});
+    put_piece(56, ROOK, true);
+    put_piece(57, KNIGHT, true);
+    put_piece(58, BISHOP, true);
+    put_piece(59, QUEEN, true);
+    put_piece(60, KING, true);
+    put_piece(61, BISHOP, true);
+    put_piece(62, KNIGHT, true);
+    put_piece(63, ROOK, true);
 }
 
 bool Tile::has_piece() const {
@@ -206,41 +303,126 @@ bool Tile::has_piece() const {
 
 void Chessboard::swap_turn() {
     white_to_move = !white_to_move;
+    key ^= ZOBRIST_KEYS.black_to_move;
 }
 
 bool Chessboard::move_piece(int start, int end) {
-    if (is_valid_move(start, end)) {
-        if (chessboard.at(start).piece->type == KING) {  // if King, update the position stored
-            if (chessboard.at(start).piece->team_white) {
-                w_king_index = end;
-            } else {
-                b_king_index = end;
-            }
+    for (const Move &move : get_legal_moves()) {
+        if (move.start() == start && move.end() == end && (move.flag() != PROMOTION || move.promotion() == QUEEN)) {
+            make_move(move);
+            return true;
         }
-        chessboard.at(end).piece.reset();                           // clear Tile the Piece is moving to
-        chessboard.at(start).piece.swap(chessboard.at(end).piece);  // swap the two Tiles
-        chessboard.at(end).piece->pos = end;                        // reset the indices after swap
-        chessboard.at(start).piece->pos = start;                    // to preserve the order of the board
-        recalculate_attackable_tiles();
-        swap_turn();
-        return true;
     }
     return false;
 }
 
-void Chessboard::move_piece_temp(int start, int end) {  // excludes a test of is_valid_move(), used when looking for checkmates to save on runtime
-    if (chessboard.at(start).piece->type == KING) {
-        if (chessboard.at(start).piece->team_white) {
-            w_king_index = end;
-        } else {
-            b_king_index = end;
+namespace {
+/// Castling rights that survive a move touching each tile, moving a king or rook (or capturing a rook) loses them
+constexpr std::array<uint8_t, 64> make_castling_masks() {
+    std::array<uint8_t, 64> masks{};
+    for (uint8_t &mask : masks) {
+        mask = ALL_CASTLING;
+    }
+    masks[0] = ALL_CASTLING & ~B_QUEEN_SIDE;
+    masks[4] = ALL_CASTLING & ~(B_KING_SIDE | B_QUEEN_SIDE);
+    masks[7] = ALL_CASTLING & ~B_KING_SIDE;
+    masks[56] = ALL_CASTLING & ~W_QUEEN_SIDE;
+    masks[60] = ALL_CASTLING & ~(W_KING_SIDE | W_QUEEN_SIDE);
+    masks[63] = ALL_CASTLING & ~W_KING_SIDE;
+    return masks;
+}
+constexpr std::array<uint8_t, 64> castling_masks = make_castling_masks();
+}  // namespace
+
+void Chessboard::make_move(Move move) {
+    bool us = white_to_move;
+    int captured_pos = move.flag() == EN_PASSANT ? move.end() + (us ? 8 : -8) : move.end();  // en passant takes the pawn behind end
+    UndoRecord undo{move, key, piece_on(captured_pos), castling_rights, ep_index};
+
+    if (undo.captured != NO_PIECE) {  // clear Tile the Piece is moving to
+        remove_piece(captured_pos);
+    }
+    relocate_piece(move.start(), move.end());  // king indices and piece counts are kept up to date by the Position
+    if (move.flag() == PROMOTION) {
+        remove_piece(move.end());
+        put_piece(move.end(), move.promotion(), us);
+    } else if (move.flag() == CASTLING) {
+        std::pair<int, int> rook = castling_rook_move(move.end());
+        relocate_piece(rook.first, rook.second);
+    }
+
+    key ^= ep_key(ep_index) ^ castling_key(castling_rights);
+    ep_index = -1;
+    if (type_of(piece_on(move.end())) == PAWN && (move.end() - move.start() == 16 || move.start() - move.end() == 16)) {
+        int skipped = (move.start() + move.end()) / 2;
+        if (pawn_attacks(skipped, us) & pieces(!us, PAWN)) {  // only when it can be captured, so equal positions share a key
+            ep_index = skipped;
         }
     }
-    chessboard.at(end).piece.reset();
-    chessboard.at(start).piece.swap(chessboard.at(end).piece);
-    chessboard.at(end).piece->pos = end;
-    chessboard.at(start).piece->pos = start;
-    recalculate_attackable_tiles();
+    castling_rights &= castling_masks[move.start()] & castling_masks[move.end()];
+    key ^= ep_key(ep_index) ^ castling_key(castling_rights);
+    swap_turn();
+    history.push_back(undo);
+#ifdef CHESS_DEBUG_CHECKS
+    verify_incremental();
+#endif
+}
+
+void Chessboard::unmake_move() {
+    UndoRecord undo = history.back();
+    history.pop_back();
+    swap_turn();
+    bool us = white_to_move;
+    Move move = undo.move;
+
+    if (move.flag() == PROMOTION) {
+        remove_piece(move.end());
+        put_piece(move.end(), PAWN, us);
+    } else if (move.flag() == CASTLING) {
+        std::pair<int, int> rook = castling_rook_move(move.end());
+        relocate_piece(rook.second, rook.first);
+    }
+    relocate_piece(move.end(), move.start());
+    if (undo.captured != NO_PIECE) {
+        int captured_pos = move.flag() == EN_PASSANT ? move.end() + (us ? 8 : -8) : move.end();
+        put_piece(captured_pos, type_of(undo.captured), is_white(undo.captured));
+    }
+    castling_rights = undo.castling_rights;
+    ep_index = undo.ep_index;
+    key = undo.key;
+#ifdef CHESS_DEBUG_CHECKS
+    verify_incremental();
+#endif
+}
+
+void Chessboard::make_null_move() {
+    history.push_back(UndoRecord{Move(), key, NO_PIECE, castling_rights, ep_index});
+    key ^= ep_key(ep_index);
+    ep_index = -1;
+    swap_turn();
+}
+
+void Chessboard::unmake_null_move() {
+    UndoRecord undo = history.back();
+    history.pop_back();
+    swap_turn();
+    ep_index = undo.ep_index;
+    key = undo.key;
+}
+
+void Chessboard::verify_incremental() const {
+    if (key != compute_key()) {
+        std::cerr << "Zobrist key out of sync after " << history.size() << " moves\n";
+        std::abort();
+    }
+    if (pawn_key != compute_pawn_key()) {
+        std::cerr << "Pawn key out of sync after " << history.size() << " moves\n";
+        std::abort();
+    }
+    if (psq != compute_psq()) {
+        std::cerr << "Piece-square score out of sync after " << history.size() << " moves\n";
+        std::abort();
+    }
 }
 
 bool Chessboard::in_bounds(int pos) {
@@ -257,62 +439,22 @@ bool Chessboard::in_bounds(int row, int col) {
     return false;
 }
 
-std::vector<std::pair<int, int>> Chessboard::reshape_vector(std::vector<int> &possible_moves, int start) {
-    std::vector<std::pair<int, int>> new_moves;
-    for (int i : possible_moves) {
-        new_moves.push_back({start, i});
-    }
-    return new_moves;
-}
-
 void Chessboard::fill_test_tiles() {
-    chessboard.clear();
+    clear_pieces();
 
-    // Place black pieces
+    // Place pieces in their starting positions
     place_starting_b_pieces();
-
-    // Fill empty tiles for the middle of the board
-    for (int i = 16; i < 48; ++i) {
-        chessboard.push_back(Tile{});
-    }
-
-    // Place white pieces
     place_starting_w_pieces();
 
     // Additional moves to show a developed game
     // Move white pawns forward
     for (int i = 48; i < 56; ++i) {
-        chessboard[i - 32].piece = Piece{i, PAWN, true};
+        relocate_piece(i, i - 16);
     }
 
     // Move black pawns forward
     for (int i = 8; i < 16; ++i) {
-        chessboard[i + 32].piece = Piece{i, PAWN, false};
+        relocate_piece(i, i + 16);
     }
-
-    // Move knights out
-    chessboard.at(1).piece = Piece{1, KNIGHT, false};
-    chessboard.at(6).piece = Piece{6, KNIGHT, false};
-    chessboard.at(57).piece = Piece{57, KNIGHT, true};
-    chessboard.at(62).piece = Piece{62, KNIGHT, true};
-
-    // Move bishops out
-    chessboard.at(2).piece = Piece{2, BISHOP, false};
-    chessboard.at(5).piece = Piece{5, BISHOP, false};
-    chessboard.at(58).piece = Piece{58, BISHOP, true};
-    chessboard.at(61).piece = Piece{61, BISHOP, true};
-
-    // Move rooks to corners
-    chessboard.at(0).piece = Piece{0, ROOK, false};
-    chessboard.at(7).piece = Piece{7, ROOK, false};
-    chessboard.at(56).piece = Piece{56, ROOK, true};
-    chessboard.at(63).piece = Piece{63, ROOK, true};
-
-    // Place queens
-    chessboard.at(3).piece = Piece{3, QUEEN, false};
-    chessboard.at(59).piece = Piece{59, QUEEN, true};
-
-    // Place kings
-    chessboard.at(4).piece = Piece{4, KING, false};
-    chessboard.at(60).piece = Piece{60, KING, true};
-}
\ No newline at end of file
+    key = compute_key();
+}
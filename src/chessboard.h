@@ -3,51 +3,88 @@
  *
  * @brief Creates, stores, and makes changes to data for a game state.
  *
- * The chessboard files are used to create, store, and make changes to data for a game state. Each game state is comprised of Tiles, and each Tile is able to have a Piece. It also has member functions that handle possible moves calculated in the piece files. The Chessboard class also differentiates between pseudo-legal moves and legal moves. This is done inside the is_valid_move() for testing one Piece's moves, and also in the is_checkmate() function which finds all legal moves for a given side.
+ * The chessboard files are used to create, store, and make changes to data for a game state. The game state itself is a bitboard Position (see position.h), and a Tile holding a Piece can be built from any of its board indices for code that wants to look at one square at a time. It also has member functions that handle possible moves calculated in the piece files. The Chessboard class also differentiates between pseudo-legal moves and legal moves. This is done inside the is_valid_move() for testing one Piece's moves, and also in the is_checkmate() function which finds all legal moves for a given side.
  */
 #pragma once
 #include <memory>
 #include <optional>
-#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 #include <vector>
 
-#include "graphics.h"
+#include "move.h"
+#include "movegen.h"
 #include "piece.h"
+#include "position.h"
 
-/// @brief Comprises a Chessboard's game state, can hold a Piece
+/// @brief One square of a Chessboard's game state, can hold a Piece
 struct Tile {
     bool has_piece() const;
     std::optional<Piece> piece;
 };
 
+/// @brief What make_move() needs to remember to take a move back
+struct UndoRecord {
+    Move move;
+    /// Zobrist key before the move, restored instead of undoing each change to it
+    uint64_t key;
+    /// Piece code that was captured, NO_PIECE if nothing was captured
+    uint8_t captured;
+    uint8_t castling_rights;
+    int8_t ep_index;
+};
+
+/// @brief Thrown for text that isn't a valid FEN or EPD record
+class FenError : public std::invalid_argument {
+   public:
+    FenError(const std::string &message, size_t offset)
+        : std::invalid_argument{message + " at offset " + std::to_string(offset)}, offset{offset} {}
+    /// Index into the text of the character the problem was found at
+    size_t offset;
+};
+
 /// @brief Used to create, store, and make changes to a game state
-class Chessboard {
+class Chessboard : public Position {
    public:
     Chessboard();
-    ~Chessboard();
-    Chessboard(Chessboard &&other);                  // move constructor
-    Chessboard &operator=(Chessboard &&other);       // move assignment
-    Chessboard(const Chessboard &other);             // copy constructor
-    Chessboard &operator=(const Chessboard &other);  // copy assignment
+    /// Game state described by fen (see set_fen()), throws FenError if it isn't valid
+    explicit Chessboard(std::string_view fen);
+    /**
+     * @brief Replaces the game state with the one text describes in Forsyth-Edwards Notation, throws FenError with the offset of the first problem.
+     *
+     * Reads the piece placement, the team to move, the castling rights and the en passant tile. With move_counters, the optional halfmove clock and fullmove number are read next and nothing but spaces may follow; without it, reading stops after the en passant tile so an EPD record's operations can follow. The text is scanned in place, nothing is allocated unless it is invalid. Castling rights whose king or rook has left its starting tile are dropped, and so is an en passant tile no pawn can capture on, like make_move() does. The history is cleared. Returns the offset just past the last field read. If text isn't valid, the game state is left as it was.
+     */
+    size_t set_fen(std::string_view text, bool move_counters = true);
+    /// Forsyth-Edwards Notation of the game state. Move counters aren't kept, so with move_counters they are always written as 0 1; without it the text is an EPD record's position
+    std::string fen(bool move_counters = true) const;
     bool is_valid_move(int start, int end);
     bool is_check();
     bool is_checkmate();
+    /// Every legal move for the team whose turn it is
+    MoveList get_legal_moves() const;
+    /// Builds the Tile for one board index, the Tile is empty when pos is out of bounds
+    Tile tile(int pos) const;
+    /// True if any piece of the given team attacks pos
+    bool is_attacked(int pos, bool by_white) const;
 
-    /// Game state
-    std::vector<Tile> chessboard;
     /// Used for highlighting within graphics and also executing moves
     int selected_piece_index;
-    /// True: white's turn | False: black's turn
-    bool white_to_move;
-    /// Store for a fast way to test for checks/mate
-    int w_king_index;
-    /// Store for a fast way to test for checks/mate
-    int b_king_index;  
-    int w_num_pieces = 16;
-    int b_num_pieces = 16;
 
+    /// Makes the legal move from start to end if there is one (pawns promote to queens), returns false otherwise
     bool move_piece(int start, int end);
-    void move_piece_temp(int start, int end);
+    /// Applies a move in place without testing it, pushing what is needed to undo it onto history
+    void make_move(Move move);
+    /// Takes back the last move applied with make_move()
+    void unmake_move();
+    /// Passes the turn without moving a piece, used by the search to test whether a position is good even without a move
+    void make_null_move();
+    /// Takes back the last make_null_move()
+    void unmake_null_move();
+    /// Undo records for every move made, most recent last
+    std::vector<UndoRecord> history;
+    /// Aborts with a message if the incrementally updated keys or psq score differ from one built from scratch, run after every make_move() and unmake_move() when built with CHESS_DEBUG_CHECKS
+    void verify_incremental() const;
      
     bool in_bounds(int pos);
     bool in_bounds(int row, int col);
@@ -58,22 +95,8 @@ class Chessboard {
     void place_starting_b_pieces();
     void place_starting_w_pieces();
 
-    /// Pseudo-legal moves could be disallowed depending on how they affect the king.
-    std::vector<std::pair<int, int>> get_all_pseudo_moves();
-    /// Legal moves are 100% legal, takes king's position/state into consideration
-    std::vector<std::pair<int, int>> get_all_legal_moves(std::vector<std::pair<int, int>> pseudo_legal);
-    /// Recalculates w_num_pieces and b_num_pieces after every change to the game state
-    void update_piece_counts(const Tile &t);
-    /// Recalculates attackable_by_white and attackable_by_black after every change to the game state
-    void recalculate_attackable_tiles();  // MUST BE CALLED AFTER EVERY MOVE
-    /// All tiles attackable by white, duplicates discarded
-    std::set<int> attackable_by_white;
-    /// All tiles attackable by black, duplicates discarded
-    std::set<int> attackable_by_black;    
-    /// Flips value of white_to_move
+    /// Flips value of white_to_move, keeping the key in sync
     void swap_turn();
 
     bool test = false;
-
-    std::vector<std::pair<int, int>> reshape_vector(std::vector<int> &possible_moves, int start);
-};
+};
\ No newline at end of file
@@ -2,16 +2,25 @@
  * @file engine.cpp
  * @brief Contains main game loop and turn handling.
  *
- * The engine class holds the game loop. This is what controls who moves what piece, where they move it to, and when they are able to move it. This is done by ither calling agent.find_best_move() to get the AI's best move, or allowing the user to make a move by handling an SDLMouseEvent (mouse click on the screen). This class also controls what is drawn to the screen using member functions within the Graphics class. The chessboard is redrawn every time a valid move or click is made.
+ * The engine class holds the game loop. This is what controls who moves what piece, where they move it to, and when they are able to move it. This is done by ither calling agent.search() to get the AI's best move within a time limit, or allowing the user to make a move by handling an SDLMouseEvent (mouse click on the screen). This class also controls what is drawn to the screen using member functions within the Graphics class. The chessboard is redrawn every time a valid move or click is made.
  */
 #include "engine.h"
 
+#include <algorithm>
 #include <iostream>
+#include <thread>
 
 #include "graphics.h"
 
 Engine::Engine(const std::string &title)
-    : graphics{title}, chessboard{}, agent{chessboard} {}
+    : graphics{title}, chessboard{}, agent{chessboard}, random{std::random_device{}()} {
+    agent.set_threads(std::max(1u, std::thread::hardware_concurrency()));  // search on every core
+    std::shared_ptr<Tablebase> tablebase{new Tablebase()};
+    if (tablebase->load("tablebases")) {  // built by tbgen, next to the assets
+        agent.tablebase = tablebase;
+    }
+    book.load("book.bin");  // optional, any Polyglot book
+}
 
 void Engine::init() {
     graphics.draw_background();
@@ -51,7 +60,7 @@ bool Engine::input() {
             handle_mouse_click(pos);
             test_for_checks();
             return true;
-        } else if (!chessboard.white_to_move) {  // agent's/black's turn
+        } else if (!chessboard.white_to_move && !chessboard.get_legal_moves().empty()) {  // agent's/black's turn, unless the game is over
             call_agent();
             test_for_checks();
             return true;
@@ -61,11 +70,15 @@ bool Engine::input() {
 }
 
 void Engine::call_agent() {
-    agent.reset_tree(chessboard);  // clears out the previous game state's tree of moves
-    std::pair<int, int> best_move;
-    int depth = 3;                            // how many moves ahead the agent will look
-    best_move = agent.find_best_move(depth);  // depth is the param here
-    handle_agent_move(best_move);
+    Move book_move = book.pick(chessboard, BOOK_WEIGHTED, random());
+    if (book_move) {  // still in the book, no need to search
+        handle_agent_move(book_move);
+        return;
+    }
+    agent.set_board(chessboard);  // search from the current game state
+    SearchLimits limits;
+    limits.movetime_ms = 1000;  // search deeper and deeper for about a second, whatever the position
+    handle_agent_move(agent.search(limits).best_move);
 }
 
 int Engine::get_mouse_click(SDL_Event event) {
@@ -83,11 +96,11 @@ int Engine::get_mouse_click(SDL_Event event) {
 }
 
 void Engine::handle_mouse_click(int pos) {
-    if (chessboard.chessboard.at(pos).has_piece() && chessboard.chessboard.at(pos).piece->team_white) {
+    if (chessboard.tile(pos).has_piece() && chessboard.tile(pos).piece->team_white) {
         // if piece exists and piece is on team white
         chessboard.selected_piece_index = pos;
         graphics.selected_tile = pos;
-    } else if (chessboard.chessboard.at(chessboard.selected_piece_index).has_piece()) {
+    } else if (chessboard.tile(chessboard.selected_piece_index).has_piece()) {
         // if a white piece is selected, and the next spot clicked is a valid move
         if (chessboard.move_piece(chessboard.selected_piece_index, pos)) {
             graphics.previous_move = {chessboard.selected_piece_index, pos};  // set previous move to be highlighted
@@ -103,9 +116,12 @@ void Engine::handle_mouse_click(int pos) {
 }
 
 void Engine::set_possible_moves() {
-    if (chessboard.chessboard.at(chessboard.selected_piece_index).has_piece()) {
-        // if piece exists
-        graphics.possible_moves = chessboard.chessboard.at(chessboard.selected_piece_index).piece->get_possible_moves(chessboard);
+    graphics.possible_moves.clear();
+    for (const Move &move : chessboard.get_legal_moves()) {
+        // legal moves of the selected piece, including castling and en passant
+        if (move.start() == chessboard.selected_piece_index) {
+            graphics.possible_moves.push_back(move.end());
+        }
     }
 }
 
@@ -127,6 +143,10 @@ void Engine::test_for_checks() {
     }
 }
 
-void Engine::handle_agent_move(std::pair<int, int> best_move) {
-    chessboard.move_piece(best_move.first, best_move.second);
+void Engine::handle_agent_move(Move best_move) {
+    if (!best_move) {  // the search finds no move when black is mated or stalemated
+        return;
+    }
+    chessboard.make_move(best_move);  // otherwise the agent only picks from legal moves
+    graphics.previous_move = {best_move.start(), best_move.end()};
 }
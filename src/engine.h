@@ -2,13 +2,15 @@
  * @file engine.h
  * @brief Contains main game loop and turn handling.
  *
- * The engine class holds the game loop. This is what controls who moves what piece, where they move it to, and when they are able to move it. This is done by ither calling agent.find_best_move() to get the AI's best move, or allowing the user to make a move by handling an SDLMouseEvent (mouse click on the screen). This class also controls what is drawn to the screen using member functions within the Graphics class. The chessboard is redrawn every time a valid move or click is made.
+ * The engine class holds the game loop. This is what controls who moves what piece, where they move it to, and when they are able to move it. This is done by ither calling agent.search() to get the AI's best move within a time limit, or allowing the user to make a move by handling an SDLMouseEvent (mouse click on the screen). This class also controls what is drawn to the screen using member functions within the Graphics class. The chessboard is redrawn every time a valid move or click is made.
  */
 #pragma once
+#include <random>
+
 #include "agent.h"
 #include "chessboard.h"
-
-class Graphics;
+#include "graphics.h"
+#include "opening_book.h"
 
 /// Contains main game loop and turn handling.
 class Engine {
@@ -23,6 +25,10 @@ class Engine {
     Chessboard chessboard;
     /// AI component to play against
     Agent agent;
+    /// Opening moves played without searching, empty when there is no book.bin
+    OpeningBook book;
+    /// Picks between the book's moves for a position
+    std::mt19937_64 random;
     bool running;
 
     /// Draw the screen for the first time
@@ -35,10 +41,10 @@ class Engine {
     int get_mouse_click(SDL_Event);
     /// Handles user input depending on what Tile was selected from get_mouse_click(SDL_Event)
     void handle_mouse_click(int);
-    /// Black's turn, call Agent find_best_move(depth) to decide on a best move
+    /// Black's turn, play a book move if there is one, otherwise call Agent search() to decide on a best move within a time limit
     void call_agent();
     /// Apply Agent's move
-    void handle_agent_move(std::pair<int, int>);
+    void handle_agent_move(Move);
     /// Show possible moves for each Piece when selected if enabled
     void set_possible_moves();
     /// Test for checks/mates after every change to the game state
@@ -0,0 +1,258 @@
+/**
+ * @file epd.cpp
+ * @brief Reads and writes test positions in Extended Position Description, and runs suites of them.
+ *
+ * SAN is matched against the legal moves rather than parsed into tiles on its own: the text gives the moving piece, the end tile, any promotion and whatever part of the start tile is needed to tell two moves apart, and exactly one legal move must fit all of them. Check and annotation marks (+ # ! ?) are ignored when reading.
+ */
+#include "epd.h"
+
+#include <cctype>
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+
+namespace {
+/// SAN letters in Type order, pawns have none
+constexpr std::string_view SAN_LETTERS = "PNBRKQ";
+
+bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+std::string tile_name(int pos) {
+    return {char('a' + pos % 8), char('8' - pos / 8)};
+}
+
+bool solves(const EpdRecord &record, Move move) {
+    auto contains = [move](const std::vector<Move> &moves) {
+        for (Move listed : moves) {
+            if (listed == move) {
+                return true;
+            }
+        }
+        return false;
+    };
+    if (record.best_moves.empty() && record.avoid_moves.empty()) {
+        return false;
+    }
+    return (record.best_moves.empty() || contains(record.best_moves)) && !contains(record.avoid_moves);
+}
+}  // namespace
+
+Move move_from_san(const Chessboard &board, std::string_view san) {
+    while (!san.empty() && (san.back() == '+' || san.back() == '#' || san.back() == '!' || san.back() == '?')) {
+        san.remove_suffix(1);
+    }
+    MoveList legal = board.get_legal_moves();
+    if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+        int end_col = san.size() == 3 ? 6 : 2;
+        for (Move move : legal) {
+            if (move.flag() == CASTLING && move.end() % 8 == end_col) {
+                return move;
+            }
+        }
+        return Move();
+    }
+
+    Type type = PAWN;
+    if (!san.empty() && SAN_LETTERS.find(san.front()) != std::string_view::npos && san.front() != 'P') {
+        type = Type(SAN_LETTERS.find(san.front()));
+        san.remove_prefix(1);
+    }
+    int promotion = -1;
+    if (san.size() >= 2 && SAN_LETTERS.find(san.back()) != std::string_view::npos) {
+        promotion = int(SAN_LETTERS.find(san.back()));
+        san.remove_suffix(san[san.size() - 2] == '=' ? 2 : 1);
+    }
+    if (san.size() < 2 || san[san.size() - 2] < 'a' || san[san.size() - 2] > 'h' || san.back() < '1' || san.back() > '8') {
+        return Move();
+    }
+    int end = ('8' - san.back()) * 8 + (san[san.size() - 2] - 'a');
+    san.remove_suffix(2);
+
+    // what is left says which piece moves: a file, a rank or both, and x for a capture
+    int start_col = -1, start_row = -1;
+    for (char c : san) {
+        if (c >= 'a' && c <= 'h') {
+            start_col = c - 'a';
+        } else if (c >= '1' && c <= '8') {
+            start_row = '8' - c;
+        } else if (c != 'x' && c != ':') {
+            return Move();
+        }
+    }
+
+    Move found;
+    for (Move move : legal) {
+        if (move.end() != end || type_of(board.piece_on(move.start())) != type ||
+            (start_col >= 0 && move.start() % 8 != start_col) || (start_row >= 0 && move.start() / 8 != start_row) ||
+            (move.flag() == PROMOTION ? promotion != int(move.promotion()) : promotion >= 0)) {
+            continue;
+        }
+        if (found) {
+            return Move();  // more than one move fits the text
+        }
+        found = move;
+    }
+    return found;
+}
+
+std::string move_to_san(const Chessboard &board, Move move) {
+    std::string san;
+    Type type = type_of(board.piece_on(move.start()));
+    bool capture = move.flag() == EN_PASSANT || !board.is_empty(move.end());
+    if (move.flag() == CASTLING) {
+        san = move.end() % 8 == 6 ? "O-O" : "O-O-O";
+    } else {
+        if (type != PAWN) {
+            san += SAN_LETTERS[type];
+            // name the start file, rank or both if another piece of the same type could also move there
+            bool other = false, same_col = false, same_row = false;
+            for (Move rival : board.get_legal_moves()) {
+                if (rival.end() == move.end() && rival.start() != move.start() && type_of(board.piece_on(rival.start())) == type) {
+                    other = true;
+                    same_col |= rival.start() % 8 == move.start() % 8;
+                    same_row |= rival.start() / 8 == move.start() / 8;
+                }
+            }
+            if (other && (!same_col || same_row)) {
+                san += char('a' + move.start() % 8);
+            }
+            if (other && same_col) {
+                san += char('8' - move.start() / 8);
+            }
+        } else if (capture) {
+            san += char('a' + move.start() % 8);
+        }
+        if (capture) {
+            san += 'x';
+        }
+        san += tile_name(move.end());
+        if (move.flag() == PROMOTION) {
+            san += '=';
+            san += SAN_LETTERS[move.promotion()];
+        }
+    }
+    Chessboard after = board;
+    after.make_move(move);
+    if (after.is_check()) {
+        san += after.get_legal_moves().empty() ? '#' : '+';
+    }
+    return san;
+}
+
+EpdRecord parse_epd(std::string_view line) {
+    EpdRecord record;
+    size_t i = record.board.set_fen(line, false);
+    while (true) {
+        while (i < line.size() && is_space(line[i])) {
+            ++i;
+        }
+        if (i == line.size()) {
+            return record;
+        }
+        size_t opcode_start = i;
+        if (!std::isalpha(static_cast<unsigned char>(line[i]))) {
+            throw FenError("operation doesn't start with an opcode", i);
+        }
+        while (i < line.size() && (std::isalnum(static_cast<unsigned char>(line[i])) || line[i] == '_')) {
+            ++i;
+        }
+        std::string_view opcode = line.substr(opcode_start, i - opcode_start);
+
+        // operands up to the semicolon, each a word or a quoted string
+        while (true) {
+            while (i < line.size() && is_space(line[i])) {
+                ++i;
+            }
+            if (i == line.size()) {
+                throw FenError("operation isn't ended by ;", i);
+            } else if (line[i] == ';') {
+                ++i;
+                break;
+            }
+            size_t operand_start = i;
+            std::string_view operand;
+            if (line[i] == '"') {
+                size_t close = line.find('"', i + 1);
+                if (close == std::string_view::npos) {
+                    throw FenError("string isn't closed", i);
+                }
+                operand = line.substr(i + 1, close - i - 1);
+                i = close + 1;
+            } else {
+                while (i < line.size() && !is_space(line[i]) && line[i] != ';') {
+                    ++i;
+                }
+                operand = line.substr(operand_start, i - operand_start);
+            }
+
+            if (opcode == "id") {
+                record.id = operand;
+            } else if (opcode == "bm" || opcode == "am") {
+                Move move = move_from_san(record.board, operand);
+                if (!move) {
+                    throw FenError("no legal move " + std::string(operand), operand_start);
+                }
+                (opcode == "bm" ? record.best_moves : record.avoid_moves).push_back(move);
+            }
+        }
+    }
+}
+
+std::string to_epd(const EpdRecord &record) {
+    std::string text = record.board.fen(false);
+    for (const auto &[opcode, moves] : {std::pair{"bm", &record.best_moves}, {"am", &record.avoid_moves}}) {
+        if (moves->empty()) {
+            continue;
+        }
+        text += std::string(" ") + opcode;
+        for (Move move : *moves) {
+            text += ' ' + move_to_san(record.board, move);
+        }
+        text += ';';
+    }
+    if (!record.id.empty()) {
+        text += " id \"" + record.id + "\";";
+    }
+    return text;
+}
+
+std::vector<EpdRecord> load_epd_file(const std::string &path) {
+    std::ifstream file{path};
+    if (!file) {
+        throw std::runtime_error("can't read " + path);
+    }
+    std::vector<EpdRecord> records;
+    std::string line;
+    for (int number = 1; std::getline(file, line); ++number) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        try {
+            records.push_back(parse_epd(line));
+        } catch (const FenError &error) {
+            throw std::runtime_error(path + " line " + std::to_string(number) + ": " + error.what());
+        }
+    }
+    return records;
+}
+
+EpdSuiteResult run_epd_suite(Agent &agent, const std::vector<EpdRecord> &records, const SearchLimits &limits, std::ostream *log) {
+    EpdSuiteResult total;
+    for (const EpdRecord &record : records) {
+        agent.tt.clear();  // so every position is searched the same way whatever came before it
+        agent.set_board(record.board);
+        SearchResult result = agent.search(limits);
+        bool solved = solves(record, result.best_move);
+        ++total.positions;
+        total.solved += solved;
+        total.nodes += result.nodes;
+        total.time_ms += result.time_ms;
+        if (log) {
+            *log << (record.id.empty() ? "#" + std::to_string(total.positions) : record.id) << "  "
+                 << (result.best_move ? move_to_san(record.board, result.best_move) : "(none)") << "  "
+                 << (solved ? "solved" : "failed") << "  depth " << result.depth << "  nodes " << result.nodes
+                 << "  " << result.time_ms << " ms\n";
+        }
+    }
+    return total;
+}
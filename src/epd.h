@@ -0,0 +1,54 @@
+/**
+ * @file epd.h
+ * @brief Reads and writes test positions in Extended Position Description, and runs suites of them.
+ *
+ * An EPD record (see https://www.chessprogramming.org/Extended_Position_Description) is the first four fields of a FEN record followed by operations, each an opcode, its operands and a semicolon: `r1b1k2r/... w kq - bm Qxf7+; id "WAC.004";`. Test suites such as Win At Chess are files of them, one per line, where `bm` lists the moves that solve the position and `am` the moves that don't. Moves in operations are in standard algebraic notation (SAN), so this file also converts between SAN and Move.
+ *
+ * Records are parsed in place from the line's text: the position through Chessboard::set_fen(), the operations by scanning for their opcodes and operands. Only the id and the moves are copied out; every other operation is checked for its syntax and skipped. Problems are reported with a FenError holding the offset into the line.
+ *
+ * run_epd_suite() searches each record's position with an Agent under the same limits, starting each one from an empty TranspositionTable so the results don't depend on the order of the suite, and totals how many it solved, the time and the positions searched.
+ */
+#pragma once
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "agent.h"
+#include "chessboard.h"
+
+/// The legal move of board written in SAN (Nf3, exd5, O-O, e8=Q+ and so on), the null move if there is none or the text could be more than one
+Move move_from_san(const Chessboard &board, std::string_view san);
+/// SAN of the legal move move of board, with + or # when it gives check or mate
+std::string move_to_san(const Chessboard &board, Move move);
+
+/// @brief One line of an EPD file
+struct EpdRecord {
+    Chessboard board;
+    /// Operand of the id operation, empty without one
+    std::string id;
+    /// Moves of the bm operation, playing any of them solves the position
+    std::vector<Move> best_moves;
+    /// Moves of the am operation, playing any of them fails the position
+    std::vector<Move> avoid_moves;
+};
+
+/// Parses one EPD record, throws FenError with the offset into line of the first problem
+EpdRecord parse_epd(std::string_view line);
+/// EPD text of record, with its bm, am and id operations
+std::string to_epd(const EpdRecord &record);
+/// Every record of the EPD file at path, skipping empty lines, throws std::runtime_error naming the line if the file can't be read or a record isn't valid
+std::vector<EpdRecord> load_epd_file(const std::string &path);
+
+/// @brief Totals of a run_epd_suite()
+struct EpdSuiteResult {
+    int positions = 0;
+    /// Positions where the move played is one of the bm moves (if there are any) and none of the am moves (if there are any)
+    int solved = 0;
+    uint64_t nodes = 0;
+    int64_t time_ms = 0;
+};
+
+/// Searches every record with agent under limits, writing one line per record to log if it isn't nullptr; records with neither bm nor am are searched but never solved
+EpdSuiteResult run_epd_suite(Agent &agent, const std::vector<EpdRecord> &records, const SearchLimits &limits, std::ostream *log = nullptr);
@@ -0,0 +1,40 @@
+/**
+ * @file epd_suite.cpp
+ * @brief Runs an EPD test suite and reports how many positions the agent solves (see epd.h).
+ *
+ * Each position is searched from an empty transposition table for movetime_ms milliseconds (0 for no time limit) and at most depth plies (0 for no depth limit), on the given number of threads. One line is printed per position, then the number solved, the total time and positions searched, and the speed. With the same depth and one thread the node counts are the same on every run.
+ *
+ * Usage: epd_suite <file> [movetime_ms] [depth] [threads]
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+
+#include "epd.h"
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: epd_suite <file> [movetime_ms] [depth] [threads]\n";
+        return 1;
+    }
+    SearchLimits limits;
+    limits.movetime_ms = argc > 2 ? std::atoll(argv[2]) : 1000;
+    int depth = argc > 3 ? std::atoi(argv[3]) : 0;
+    if (depth > 0) {
+        limits.depth = std::min(depth, MAX_PLY - 1);
+    }
+    int threads = argc > 4 ? std::max(1, std::atoi(argv[4])) : 1;
+
+    try {
+        std::vector<EpdRecord> records = load_epd_file(argv[1]);
+        Agent agent{Chessboard()};
+        agent.set_threads(threads);
+        EpdSuiteResult result = run_epd_suite(agent, records, limits, &std::cout);
+        std::cout << "solved " << result.solved << " of " << result.positions << ", " << result.time_ms << " ms, "
+                  << result.nodes << " nodes, " << result.nodes * 1000 / uint64_t(std::max<int64_t>(result.time_ms, 1)) << " nodes/s\n";
+    } catch (const std::exception &error) {
+        std::cerr << "epd_suite: " << error.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,28 @@
+/**
+ * @file eval_cache.cpp
+ * @brief Remembers the static evaluation of positions the Agent has already evaluated.
+ *
+ * Probing and storing are inline in the header since they run at every leaf, only allocation and clearing live here. A cleared slot holds 0, which a key whose upper 48 bits are all 0 would match; at one key in 2^48 that is left alone rather than paid for with a check on every probe.
+ */
+#include "eval_cache.h"
+
+EvalCache::EvalCache(size_t size_mb) {
+    resize(size_mb);
+}
+
+void EvalCache::resize(size_t size_mb) {
+    size_t count = 1;
+    size_t bytes = (size_mb < 1 ? 1 : size_mb) << 20;
+    while (count * 2 * sizeof(uint64_t) <= bytes) {
+        count *= 2;
+    }
+    slots.reset(new std::atomic<uint64_t>[count]);
+    mask = count - 1;
+    clear();
+}
+
+void EvalCache::clear() {
+    for (size_t i = 0; i <= mask; ++i) {
+        slots[i].store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,44 @@
+/**
+ * @file eval_cache.h
+ * @brief Remembers the static evaluation of positions the Agent has already evaluated.
+ *
+ * The leaves of one iteration are searched again by the next, and transpositions reach the same positions through other moves, so the same positions are evaluated over and over. The EvalCache maps a position's Zobrist key to its static evaluation, so a repeat costs one memory read instead of a full evaluation (see https://www.chessprogramming.org/Evaluation_Hash_Table).
+ *
+ * Each slot is a single 64 bit word, the upper 48 bits of the key with the 16 bit score below them, written and read with one relaxed atomic operation. Threads share one cache without locks, and since a slot is never half written, a probe either finds a whole entry or a miss. A new score always replaces the old one in its slot. The cache is sized on its own, apart from the TranspositionTable.
+ */
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/// @brief Fixed size, lock free cache of static evaluations shared by every thread
+class EvalCache {
+   public:
+    explicit EvalCache(size_t size_mb = 4);
+
+    /// Reallocates the cache with the largest power of two number of slots fitting in size_mb (at least 1) and clears it
+    void resize(size_t size_mb);
+    /// Forgets every score
+    void clear();
+
+    /// Sets score and returns true if the cache has a score for key
+    bool probe(uint64_t key, int &score) const {
+        uint64_t slot = slots[key & mask].load(std::memory_order_relaxed);
+        if ((slot ^ key) >> 16) {
+            return false;
+        }
+        score = int16_t(slot & 0xFFFF);
+        return true;
+    }
+    /// Stores the static evaluation of the position with key, it must fit in 16 bits
+    void store(uint64_t key, int score) {
+        slots[key & mask].store((key & ~0xFFFFULL) | uint16_t(int16_t(score)), std::memory_order_relaxed);
+    }
+
+    size_t size_mb() const { return (mask + 1) * sizeof(uint64_t) >> 20; }
+
+   private:
+    std::unique_ptr<std::atomic<uint64_t>[]> slots;
+    uint64_t mask;
+};
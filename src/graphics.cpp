@@ -113,7 +113,8 @@ void Graphics::draw_board() {
 }
 
 void Graphics::draw_pieces(Chessboard &chessboard) {
-    for (const Tile &t : chessboard.chessboard) {
+    for (int i = 0; i < grid_size * grid_size; ++i) {
+        Tile t = chessboard.tile(i);
         if (t.piece) {
             std::pair<int, int> pos = board_to_pixel(t.piece->pos);
             SDL_Rect rectPos = {pos.first, pos.second, tile_size, tile_size};
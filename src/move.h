@@ -0,0 +1,77 @@
+/**
+ * @file move.h
+ * @brief The Move passed to Chessboard::make_move() and the MoveList generators fill.
+ *
+ * A Move is packed into 16 bits: the board index a piece leaves (6 bits), the board index it lands on (6 bits), the piece a pawn promotes to (2 bits) and a flag for the three moves that do more than relocate one piece: promotions, en passant captures and castling (2 bits). Castling is stored as the king's move, two tiles towards the rook. Everything else needed to take the move back (what was captured, lost castling rights, and so on) is recorded by the Chessboard when the move is made.
+ *
+ * A MoveList is a fixed capacity array of Moves meant to live on the stack, so generating the moves of a position never touches the heap.
+ */
+#pragma once
+#include <cstdint>
+
+#include "piece.h"
+
+enum MoveFlag : uint8_t {
+    NORMAL,
+    PROMOTION,
+    EN_PASSANT,
+    CASTLING
+};
+
+/// @brief One piece moving from start to end, packed into 16 bits
+class Move {
+   public:
+    /// The null move (0 to 0), never legal, used as "no move"
+    constexpr Move() : data{0} {}
+    constexpr Move(int start, int end, MoveFlag flag = NORMAL, Type promotion = KNIGHT)
+        : data{uint16_t(start | end << 6 | promotion_code(promotion) << 12 | flag << 14)} {}
+
+    constexpr int start() const { return data & 0x3F; }
+    constexpr int end() const { return (data >> 6) & 0x3F; }
+    constexpr MoveFlag flag() const { return MoveFlag(data >> 14); }
+    /// Type the pawn becomes, only meaningful when flag() is PROMOTION
+    constexpr Type promotion() const { return PROMOTION_TYPES[(data >> 12) & 3]; }
+
+    /// Packed 16 bit value, for storing a Move in tables
+    constexpr uint16_t raw() const { return data; }
+    static constexpr Move from_raw(uint16_t raw) {
+        Move move;
+        move.data = raw;
+        return move;
+    }
+
+    constexpr bool operator==(const Move &other) const { return data == other.data; }
+    constexpr bool operator!=(const Move &other) const { return data != other.data; }
+    explicit constexpr operator bool() const { return data != 0; }
+
+   private:
+    static constexpr Type PROMOTION_TYPES[4] = {KNIGHT, BISHOP, ROOK, QUEEN};
+    static constexpr int promotion_code(Type type) { return type == QUEEN ? 3 : type == ROOK ? 2 : type == BISHOP ? 1 : 0; }
+
+    uint16_t data;
+};
+
+static_assert(sizeof(Move) == 2, "Move must stay packed into 16 bits");
+
+/// More than the most moves any legal position has (218)
+constexpr int MAX_MOVES = 256;
+
+/// @brief Fixed capacity list of Moves, lives on the stack so move generation never allocates
+class MoveList {
+   public:
+    void push_back(Move move) { moves[count++] = move; }
+    void clear() { count = 0; }
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    Move &operator[](int i) { return moves[i]; }
+    const Move &operator[](int i) const { return moves[i]; }
+    Move *begin() { return moves; }
+    Move *end() { return moves + count; }
+    const Move *begin() const { return moves; }
+    const Move *end() const { return moves + count; }
+
+   private:
+    Move moves[MAX_MOVES];
+    int count = 0;
+};
@@ -0,0 +1,105 @@
+/**
+ * @file move_order.cpp
+ * @brief Sorts moves so the ones most likely to be best are searched first.
+ *
+ * Every move gets one score, and the score ranges of each kind of move don't overlap: the TranspositionTable move, then captures and promotions, then killers, then quiet moves by history, and last the captures the static exchange evaluation (see.h) says lose material. Moves are then picked one at a time with a partial selection sort, since most cutoffs happen within the first few moves and sorting the rest would be wasted work.
+ */
+#include "move_order.h"
+
+#include <utility>
+
+#include "see.h"
+
+namespace {
+/// MVV-LVA weights by Type, the king is the least wanted attacker and is never a victim
+constexpr int ORDER_VALUES[6] = {1, 3, 3, 5, 10, 9};
+
+constexpr int TT_MOVE_SCORE = 1 << 30;
+constexpr int CAPTURE_SCORE = 1 << 28;
+constexpr int KILLER_SCORE = 1 << 27;
+/// Captures the static exchange says lose material go after every quiet move
+constexpr int BAD_CAPTURE_SCORE = -(1 << 28);
+/// History scores are kept below the killers
+constexpr int MAX_HISTORY = 1 << 26;
+}  // namespace
+
+void MoveOrder::clear() {
+    for (auto &ply_killers : killers) {
+        ply_killers[0] = ply_killers[1] = Move();
+    }
+    for (auto &team : history) {
+        for (auto &start : team) {
+            for (int &score : start) {
+                score = 0;
+            }
+        }
+    }
+}
+
+void MoveOrder::new_search() {
+    for (auto &ply_killers : killers) {
+        ply_killers[0] = ply_killers[1] = Move();
+    }
+    for (auto &team : history) {
+        for (auto &start : team) {
+            for (int &score : start) {
+                score /= 2;
+            }
+        }
+    }
+}
+
+void MoveOrder::score_moves(const Position &position, const MoveList &moves, Move tt_move, int ply, int *scores) const {
+    bool us = position.white_to_move;
+    for (int i = 0; i < moves.size(); ++i) {
+        Move move = moves[i];
+        if (move == tt_move) {
+            scores[i] = TT_MOVE_SCORE;
+        } else if (is_capture(position, move) || move.flag() == PROMOTION) {
+            int victim = move.flag() == EN_PASSANT ? PAWN : type_of(position.piece_on(move.end()));
+            int victim_value = is_capture(position, move) ? ORDER_VALUES[victim] : 0;
+            int promotion_value = move.flag() == PROMOTION ? ORDER_VALUES[move.promotion()] : 0;
+            int attacker_value = ORDER_VALUES[type_of(position.piece_on(move.start()))];
+            int mvv_lva = (victim_value + promotion_value) * 16 - attacker_value;
+            // taking a piece worth at least the attacker can't lose material, only look closer at the rest
+            bool losing = victim_value < attacker_value && !promotion_value && static_exchange(position, move) < 0;
+            scores[i] = (losing ? BAD_CAPTURE_SCORE : CAPTURE_SCORE) + mvv_lva;
+        } else if (move == killers[ply][0]) {
+            scores[i] = KILLER_SCORE + 1;
+        } else if (move == killers[ply][1]) {
+            scores[i] = KILLER_SCORE;
+        } else {
+            scores[i] = history[us][move.start()][move.end()];
+        }
+    }
+}
+
+Move MoveOrder::pick_move(MoveList &moves, int *scores, int i) {
+    int best = i;
+    for (int j = i + 1; j < moves.size(); ++j) {
+        if (scores[j] > scores[best]) {
+            best = j;
+        }
+    }
+    std::swap(moves[i], moves[best]);
+    std::swap(scores[i], scores[best]);
+    return moves[i];
+}
+
+void MoveOrder::update_quiet_cutoff(const Position &position, Move move, int ply, int depth) {
+    if (killers[ply][0] != move) {
+        killers[ply][1] = killers[ply][0];
+        killers[ply][0] = move;
+    }
+    int &score = history[position.white_to_move][move.start()][move.end()];
+    score += depth * depth;
+    if (score >= MAX_HISTORY) {  // keep every score in range and their ratios intact
+        for (auto &team : history) {
+            for (auto &start : team) {
+                for (int &s : start) {
+                    s /= 2;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,42 @@
+/**
+ * @file move_order.h
+ * @brief Sorts moves so the ones most likely to be best are searched first.
+ *
+ * Alpha beta pruning cuts off a branch as soon as one move is shown to be good enough, so the sooner the best move is searched the less of the tree is visited. Moves are tried in this order: the best move stored in the TranspositionTable for the position, then captures with the most valuable victim and least valuable attacker first (MVV-LVA), then the two "killer" quiet moves that last caused a cutoff at the same ply, then the rest of the quiet moves by their history score, which grows every time that move (by team, start and end tile) causes a cutoff anywhere in the search, and finally captures that lose material once the recaptures are played out (see https://www.chessprogramming.org/Move_Ordering).
+ */
+#pragma once
+#include "move.h"
+#include "position.h"
+#include "transposition_table.h"
+
+/// @brief Killer moves and history scores learned while searching, used to score moves for ordering
+class MoveOrder {
+   public:
+    MoveOrder() { clear(); }
+    /// Forgets every killer and history score
+    void clear();
+    /// Called before each search, halves the history scores so the latest searches count for more
+    void new_search();
+
+    /// Fills scores with how early each move in moves should be searched, higher first
+    void score_moves(const Position &position, const MoveList &moves, Move tt_move, int ply, int *scores) const;
+    /// Swaps the highest scoring move from index i onwards into i and returns it, so sorting stops early if a cutoff comes first
+    static Move pick_move(MoveList &moves, int *scores, int i);
+    /// Learns from a quiet move (not a capture or promotion) that caused a beta cutoff
+    void update_quiet_cutoff(const Position &position, Move move, int ply, int depth);
+
+    /// How often a quiet move has caused cutoffs, scaled so deeper cutoffs count for more
+    int history_score(const Position &position, Move move) const { return history[position.white_to_move][move.start()][move.end()]; }
+
+    static bool is_capture(const Position &position, Move move) {
+        return !position.is_empty(move.end()) || move.flag() == EN_PASSANT;
+    }
+    static bool is_quiet(const Position &position, Move move) {
+        return !is_capture(position, move) && move.flag() != PROMOTION;
+    }
+
+   private:
+    Move killers[MAX_PLY][2];
+    /// Indexed by [team_white][start][end]
+    int history[2][64][64];
+};
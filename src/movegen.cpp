@@ -0,0 +1,190 @@
+/**
+ * @file movegen.cpp
+ * @brief Generates every legal move for the team whose turn it is.
+ *
+ * The checkers, check mask and pinned pieces are found once at the start of generate_legal_moves(). Pinned pieces may only move along the line between their king and the piece pinning them, and while in check every move other than a king move must capture the checking piece or block its ray. King moves are tested against the enemy's attacks with the king lifted off the board, and en passant is tested by removing both pawns, since it is the one capture that can uncover a check along a row.
+ *
+ * generate_legal_captures() runs the same code with every target set limited to enemy pieces (plus the promotion row for pawn pushes) and skips castling, so the quiescence search never pays for quiet moves it would throw away.
+ */
+#include "movegen.h"
+
+namespace {
+/// @brief Tiles involved in one castling move
+struct CastlingMove {
+    CastlingRight right;
+    int king_start;
+    int king_end;
+    int rook_start;
+};
+
+const CastlingMove castling_moves[4] = {
+    {W_KING_SIDE, 60, 62, 63},
+    {W_QUEEN_SIDE, 60, 58, 56},
+    {B_KING_SIDE, 4, 6, 7},
+    {B_QUEEN_SIDE, 4, 2, 0},
+};
+
+void add_moves(int start, Bitboard targets, MoveList &moves) {
+    while (targets) {
+        moves.push_back(Move{start, pop_lsb(targets)});
+    }
+}
+
+void add_pawn_moves(int start, Bitboard targets, Bitboard promotion_row, MoveList &moves) {
+    while (targets) {
+        int end = pop_lsb(targets);
+        if (square_bb(end) & promotion_row) {
+            for (Type type : {QUEEN, KNIGHT, ROOK, BISHOP}) {
+                moves.push_back(Move{start, end, PROMOTION, type});
+            }
+        } else {
+            moves.push_back(Move{start, end});
+        }
+    }
+}
+
+bool is_attacked_by(const Position &position, int pos, bool by_white, Bitboard occupied) {
+    return attackers_to(position, pos, occupied) & position.pieces(by_white);
+}
+}  // namespace
+
+Bitboard attackers_to(const Position &position, int pos, Bitboard occupied) {
+    return (pawn_attacks(pos, false) & position.pieces(true, PAWN)) |  // white pawns sit where a black pawn on pos would attack
+           (pawn_attacks(pos, true) & position.pieces(false, PAWN)) |
+           (knight_attacks(pos) & position.type_bb[KNIGHT]) |
+           (king_attacks(pos) & position.type_bb[KING]) |
+           (rook_attacks(pos, occupied) & (position.type_bb[ROOK] | position.type_bb[QUEEN])) |
+           (bishop_attacks(pos, occupied) & (position.type_bb[BISHOP] | position.type_bb[QUEEN]));
+}
+
+namespace {
+/// Shared by generate_legal_moves() and generate_legal_captures(), the flag is known at compile time so the unused checks disappear
+template <bool CAPTURES_ONLY>
+void generate(const Position &position, MoveList &moves) {
+    bool us = position.white_to_move;
+    int king = position.king_index(us);
+    Bitboard own = position.pieces(us);
+    Bitboard enemy = position.pieces(!us);
+    Bitboard occupied = own | enemy;
+
+    // Every move below lands on one of these, captures only look at enemy pieces
+    Bitboard allowed_targets = CAPTURES_ONLY ? enemy : ~own;
+
+    // King moves, tested with the king lifted off the board so it can't step back along a slider's ray
+    Bitboard king_targets = king_attacks(king) & allowed_targets;
+    while (king_targets) {
+        int end = pop_lsb(king_targets);
+        if (!is_attacked_by(position, end, !us, occupied ^ square_bb(king))) {
+            moves.push_back(Move{king, end});
+        }
+    }
+
+    Bitboard checkers = attackers_to(position, king, occupied) & enemy;
+    if (popcount(checkers) > 1) {  // double check, only the king can move
+        return;
+    }
+    // Every other move has to capture the checker or block its ray
+    Bitboard check_mask = checkers ? between(king, lsb(checkers)) | checkers : ~EMPTY_BB;
+
+    // Pinned pieces: the only piece of ours between the king and an enemy slider looking at it
+    Bitboard pinned = EMPTY_BB;
+    Bitboard snipers = (rook_attacks(king, enemy) & position.pieces(!us, ROOK)) |
+                       (bishop_attacks(king, enemy) & position.pieces(!us, BISHOP)) |
+                       (queen_attacks(king, enemy) & position.pieces(!us, QUEEN));
+    while (snipers) {
+        Bitboard blockers = between(king, pop_lsb(snipers)) & occupied;
+        if (popcount(blockers) == 1) {
+            pinned |= blockers & own;
+        }
+    }
+
+    Bitboard targets = allowed_targets & check_mask;
+
+    Bitboard knights = position.pieces(us, KNIGHT) & ~pinned;  // a pinned knight can never stay on the pin line
+    while (knights) {
+        int start = pop_lsb(knights);
+        add_moves(start, knight_attacks(start) & targets, moves);
+    }
+
+    Bitboard sliders = position.pieces(us, BISHOP) | position.pieces(us, ROOK) | position.pieces(us, QUEEN);
+    while (sliders) {
+        int start = pop_lsb(sliders);
+        Bitboard attacks = EMPTY_BB;
+        switch (type_of(position.piece_on(start))) {
+            case BISHOP:
+                attacks = bishop_attacks(start, occupied);
+                break;
+            case ROOK:
+                attacks = rook_attacks(start, occupied);
+                break;
+            default:
+                attacks = queen_attacks(start, occupied);
+                break;
+        }
+        if (pinned & square_bb(start)) {
+            attacks &= line(king, start);
+        }
+        add_moves(start, attacks & targets, moves);
+    }
+
+    int forward = us ? -8 : 8;
+    Bitboard promotion_row = us ? ROW_0_BB : ROW_7_BB;
+    Bitboard double_push_row = us ? ROW_0_BB << 48 : ROW_0_BB << 8;
+    Bitboard pawns = position.pieces(us, PAWN);
+    while (pawns) {
+        int start = pop_lsb(pawns);
+        Bitboard allowed = check_mask;
+        if (pinned & square_bb(start)) {
+            allowed &= line(king, start);
+        }
+
+        Bitboard pawn_targets = pawn_attacks(start, us) & enemy;
+        int one_forward = start + forward;
+        // promotions count as captures, they change the material just as much
+        if (!(occupied & square_bb(one_forward)) && (!CAPTURES_ONLY || (square_bb(one_forward) & promotion_row))) {
+            pawn_targets |= square_bb(one_forward);
+            if (!CAPTURES_ONLY && (double_push_row & square_bb(start)) && !(occupied & square_bb(one_forward + forward))) {
+                pawn_targets |= square_bb(one_forward + forward);
+            }
+        }
+        add_pawn_moves(start, pawn_targets & allowed, promotion_row, moves);
+
+        if (position.ep_index != -1 && (pawn_attacks(start, us) & square_bb(position.ep_index))) {
+            // Lift both pawns off the board and look for any attack on the king, this also covers a pin along the row
+            int captured = position.ep_index - forward;
+            Bitboard after = (occupied ^ square_bb(start) ^ square_bb(captured)) | square_bb(position.ep_index);
+            if (!(attackers_to(position, king, after) & enemy & ~square_bb(captured))) {
+                moves.push_back(Move{start, position.ep_index, EN_PASSANT});
+            }
+        }
+    }
+
+    if (!CAPTURES_ONLY && !checkers) {
+        for (int i = us ? 0 : 2; i < (us ? 2 : 4); ++i) {  // white's two castling moves come first
+            const CastlingMove &castle = castling_moves[i];
+            if (!(position.castling_rights & castle.right) || castle.king_start != king ||
+                position.piece_on(castle.rook_start) != make_piece(ROOK, us) ||
+                (occupied & between(king, castle.rook_start))) {
+                continue;
+            }
+            // the king may not pass through or land on an attacked tile
+            Bitboard path = between(king, castle.king_end) | square_bb(castle.king_end);
+            bool safe = true;
+            while (path && safe) {
+                safe = !is_attacked_by(position, pop_lsb(path), !us, occupied);
+            }
+            if (safe) {
+                moves.push_back(Move{king, castle.king_end, CASTLING});
+            }
+        }
+    }
+}
+}  // namespace
+
+void generate_legal_moves(const Position &position, MoveList &moves) {
+    generate<false>(position, moves);
+}
+
+void generate_legal_captures(const Position &position, MoveList &moves) {
+    generate<true>(position, moves);
+}
@@ -0,0 +1,18 @@
+/**
+ * @file movegen.h
+ * @brief Generates every legal move for the team whose turn it is.
+ *
+ * Legal moves are found without ever trying a move on the board. Once per position the generator works out which enemy pieces give check, which tiles a move must land on to deal with that check, and which of the moving team's pieces are pinned to their king (and the line they may still move along). Every piece's moves are then masked by those sets, so only legal moves are produced. King moves, castling and en passant get their own checks, and in double check only the king is allowed to move.
+ */
+#pragma once
+#include "bitboard.h"
+#include "move.h"
+#include "position.h"
+
+/// Pieces of both teams attacking pos, with the given tiles occupied
+Bitboard attackers_to(const Position &position, int pos, Bitboard occupied);
+
+/// Appends every legal move for the team whose turn it is to moves, never allocates
+void generate_legal_moves(const Position &position, MoveList &moves);
+/// Appends only the legal captures (en passant included) and promotions, for searching the end of capture sequences
+void generate_legal_captures(const Position &position, MoveList &moves);
@@ -0,0 +1,372 @@
+/**
+ * @file nnue.cpp
+ * @brief Optional neural network evaluation, efficiently updated as moves are made (NNUE).
+ *
+ * Each kernel comes in three versions. The AVX2 and SSE4.1 ones are compiled with GCC's target attribute, so the rest of the build needs no special flags, and the table of kernels for the running CPU is picked with best_simd_level(). All three give exactly the same results: accumulator values wrap around like int16 additions do, and the int8 layers sum in int32 before scaling.
+ *
+ * The accumulators are clamped to 0..127 so they fit the unsigned side of the multiply-add instructions (pmaddubsw), which multiply unsigned bytes by signed bytes and add neighbouring pairs into int16. Two products of at most 127 x 128 fit in an int16, so those sums never saturate.
+ */
+#include "nnue.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef CHESS_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+constexpr char MAGIC[8] = {'C', 'H', 'E', 'S', 'S', 'N', 'N', '1'};
+/// Hidden layer sums are divided by 2^HIDDEN_SHIFT before clamping to 0..127
+constexpr int HIDDEN_SHIFT = 6;
+/// The output layer's sum is divided by this to give centipawns
+constexpr int OUTPUT_SCALE = 16;
+
+/// Input for a piece on pos seen from perspective's side, black's view is flipped so both teams use the same weights
+int feature_index(bool perspective, int king_pos, uint8_t piece, int pos) {
+    if (!perspective) {
+        king_pos ^= 56;
+        pos ^= 56;
+    }
+    Type type = type_of(piece);
+    int type_index = type == QUEEN ? 4 : type;  // kings are never inputs, queens take their slot
+    int team_index = is_white(piece) == perspective ? 0 : 5;
+    return (king_pos * 10 + team_index + type_index) * 64 + pos;
+}
+
+int clamp_byte(int value) {
+    return value < 0 ? 0 : value > 127 ? 127 : value;
+}
+
+/// out = in - every removed row + every added row, NNUE_L1 values
+void update_scalar(const int16_t *in, int16_t *out, const int16_t *const *removed, int removed_count, const int16_t *const *added, int added_count) {
+    for (int i = 0; i < NNUE_L1; ++i) {
+        int16_t value = in[i];
+        for (int r = 0; r < removed_count; ++r) {
+            value = int16_t(value - removed[r][i]);
+        }
+        for (int a = 0; a < added_count; ++a) {
+            value = int16_t(value + added[a][i]);
+        }
+        out[i] = value;
+    }
+}
+
+/// NNUE_L1 accumulator values clamped to 0..127
+void clipped_relu_scalar(const int16_t *in, uint8_t *out) {
+    for (int i = 0; i < NNUE_L1; ++i) {
+        out[i] = uint8_t(clamp_byte(in[i]));
+    }
+}
+
+/// Dot product of n unsigned inputs with n signed weights
+int32_t dot_scalar(const uint8_t *in, const int8_t *weights, int n) {
+    int32_t sum = 0;
+    for (int i = 0; i < n; ++i) {
+        sum += in[i] * weights[i];
+    }
+    return sum;
+}
+
+#ifdef CHESS_SIMD_X86
+__attribute__((target("sse4.1"))) void update_sse41(const int16_t *in, int16_t *out, const int16_t *const *removed, int removed_count, const int16_t *const *added, int added_count) {
+    for (int i = 0; i < NNUE_L1; i += 8) {
+        __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        for (int r = 0; r < removed_count; ++r) {
+            value = _mm_sub_epi16(value, _mm_loadu_si128(reinterpret_cast<const __m128i *>(removed[r] + i)));
+        }
+        for (int a = 0; a < added_count; ++a) {
+            value = _mm_add_epi16(value, _mm_loadu_si128(reinterpret_cast<const __m128i *>(added[a] + i)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), value);
+    }
+}
+
+__attribute__((target("sse4.1"))) void clipped_relu_sse41(const int16_t *in, uint8_t *out) {
+    const __m128i zero = _mm_setzero_si128();
+    for (int i = 0; i < NNUE_L1; i += 16) {
+        __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i + 8));
+        __m128i packed = _mm_packs_epi16(low, high);  // saturates to -128..127
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_max_epi8(packed, zero));
+    }
+}
+
+__attribute__((target("sse4.1"))) int32_t dot_sse41(const uint8_t *in, const int8_t *weights, int n) {
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i sum = _mm_setzero_si128();
+    for (int i = 0; i < n; i += 16) {
+        __m128i product = _mm_maddubs_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)),
+                                            _mm_loadu_si128(reinterpret_cast<const __m128i *>(weights + i)));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(product, ones));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+}
+
+__attribute__((target("avx2"))) void update_avx2(const int16_t *in, int16_t *out, const int16_t *const *removed, int removed_count, const int16_t *const *added, int added_count) {
+    for (int i = 0; i < NNUE_L1; i += 16) {
+        __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+        for (int r = 0; r < removed_count; ++r) {
+            value = _mm256_sub_epi16(value, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(removed[r] + i)));
+        }
+        for (int a = 0; a < added_count; ++a) {
+            value = _mm256_add_epi16(value, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(added[a] + i)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), value);
+    }
+}
+
+__attribute__((target("avx2"))) void clipped_relu_avx2(const int16_t *in, uint8_t *out) {
+    const __m256i zero = _mm256_setzero_si256();
+    for (int i = 0; i < NNUE_L1; i += 32) {
+        __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+        __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i + 16));
+        // packs works within 128 bit lanes, the permute puts the four quarters back in order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(low, high), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_max_epi8(packed, zero));
+    }
+}
+
+__attribute__((target("avx2"))) int32_t dot_avx2(const uint8_t *in, const int8_t *weights, int n) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i sum = _mm256_setzero_si256();
+    for (int i = 0; i < n; i += 32) {
+        __m256i product = _mm256_maddubs_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i)),
+                                               _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + i)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(product, ones));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+    return _mm_cvtsi128_si32(half);
+}
+#endif
+
+/// @brief One version of every kernel
+struct Kernels {
+    void (*update)(const int16_t *in, int16_t *out, const int16_t *const *removed, int removed_count, const int16_t *const *added, int added_count);
+    void (*clipped_relu)(const int16_t *in, uint8_t *out);
+    int32_t (*dot)(const uint8_t *in, const int8_t *weights, int n);
+};
+
+/// Indexed by SimdLevel
+#ifdef CHESS_SIMD_X86
+const Kernels KERNELS[3] = {
+    {update_scalar, clipped_relu_scalar, dot_scalar},
+    {update_sse41, clipped_relu_sse41, dot_sse41},
+    {update_avx2, clipped_relu_avx2, dot_avx2},
+};
+#else
+const Kernels KERNELS[3] = {
+    {update_scalar, clipped_relu_scalar, dot_scalar},
+    {update_scalar, clipped_relu_scalar, dot_scalar},
+    {update_scalar, clipped_relu_scalar, dot_scalar},
+};
+#endif
+
+template <typename T>
+void read_array(std::istream &in, T *data, size_t count, const std::string &path) {
+    if (!in.read(reinterpret_cast<char *>(data), std::streamsize(count * sizeof(T)))) {  // the file is little endian, like every CPU this runs on
+        throw std::runtime_error("NNUE file '" + path + "' is truncated");
+    }
+}
+
+template <typename T>
+void write_array(std::ostream &out, const T *data, size_t count) {
+    out.write(reinterpret_cast<const char *>(data), std::streamsize(count * sizeof(T)));
+}
+}  // namespace
+
+/// @brief Every weight of the network, about 20 MB, nearly all of it the feature weights
+struct NnueNetwork::Weights {
+    alignas(64) int16_t feature_biases[NNUE_L1];
+    alignas(64) int16_t feature_weights[NNUE_INPUTS][NNUE_L1];
+    alignas(64) int32_t hidden1_biases[NNUE_L2];
+    alignas(64) int8_t hidden1_weights[NNUE_L2][2 * NNUE_L1];
+    alignas(64) int32_t hidden2_biases[NNUE_L3];
+    alignas(64) int8_t hidden2_weights[NNUE_L3][NNUE_L2];
+    int32_t output_bias;
+    alignas(64) int8_t output_weights[NNUE_L3];
+};
+
+NnueNetwork::NnueNetwork() : weights{new Weights()}, simd{best_simd_level()} {}
+
+NnueNetwork::~NnueNetwork() = default;
+
+std::unique_ptr<NnueNetwork> NnueNetwork::load(const std::string &path) {
+    std::ifstream in{path, std::ios::binary};
+    if (!in) {
+        throw std::runtime_error("Unable to open NNUE file '" + path + "'");
+    }
+    char magic[8];
+    read_array(in, magic, 8, path);
+    if (!std::equal(magic, magic + 8, MAGIC)) {
+        throw std::runtime_error("'" + path + "' is not an NNUE file");
+    }
+    std::unique_ptr<NnueNetwork> network{new NnueNetwork()};
+    Weights &w = *network->weights;
+    read_array(in, w.feature_biases, NNUE_L1, path);
+    read_array(in, &w.feature_weights[0][0], size_t(NNUE_INPUTS) * NNUE_L1, path);
+    read_array(in, w.hidden1_biases, NNUE_L2, path);
+    read_array(in, &w.hidden1_weights[0][0], NNUE_L2 * 2 * NNUE_L1, path);
+    read_array(in, w.hidden2_biases, NNUE_L3, path);
+    read_array(in, &w.hidden2_weights[0][0], NNUE_L3 * NNUE_L2, path);
+    read_array(in, &w.output_bias, 1, path);
+    read_array(in, w.output_weights, NNUE_L3, path);
+    if (in.peek() != std::char_traits<char>::eof()) {
+        throw std::runtime_error("NNUE file '" + path + "' is larger than this network, it was made for another architecture");
+    }
+    return network;
+}
+
+void NnueNetwork::save(const std::string &path) const {
+    std::ofstream out{path, std::ios::binary};
+    const Weights &w = *weights;
+    write_array(out, MAGIC, 8);
+    write_array(out, w.feature_biases, NNUE_L1);
+    write_array(out, &w.feature_weights[0][0], size_t(NNUE_INPUTS) * NNUE_L1);
+    write_array(out, w.hidden1_biases, NNUE_L2);
+    write_array(out, &w.hidden1_weights[0][0], NNUE_L2 * 2 * NNUE_L1);
+    write_array(out, w.hidden2_biases, NNUE_L3);
+    write_array(out, &w.hidden2_weights[0][0], NNUE_L3 * NNUE_L2);
+    write_array(out, &w.output_bias, 1);
+    write_array(out, w.output_weights, NNUE_L3);
+    if (!out) {
+        throw std::runtime_error("Unable to write NNUE file '" + path + "'");
+    }
+}
+
+void NnueNetwork::randomize(uint64_t seed) {
+    uint64_t state = seed;
+    // uniform in -range..range
+    auto random = [&state](int range) { return int(zobrist_random(state) % uint64_t(2 * range + 1)) - range; };
+    Weights &w = *weights;
+    for (int16_t &bias : w.feature_biases) {
+        bias = int16_t(random(16) + 16);
+    }
+    for (auto &row : w.feature_weights) {
+        for (int16_t &weight : row) {
+            weight = int16_t(random(8));
+        }
+    }
+    for (int32_t &bias : w.hidden1_biases) {
+        bias = random(512);
+    }
+    for (auto &row : w.hidden1_weights) {
+        for (int8_t &weight : row) {
+            weight = int8_t(random(16));
+        }
+    }
+    for (int32_t &bias : w.hidden2_biases) {
+        bias = random(512);
+    }
+    for (auto &row : w.hidden2_weights) {
+        for (int8_t &weight : row) {
+            weight = int8_t(random(32));
+        }
+    }
+    w.output_bias = 0;
+    for (int8_t &weight : w.output_weights) {
+        weight = int8_t(random(64));
+    }
+}
+
+void NnueNetwork::set_simd_level(SimdLevel level) {
+    simd = level < best_simd_level() ? level : best_simd_level();
+}
+
+void NnueNetwork::refresh_perspective(const Position &position, NnueAccumulator &accumulator, bool perspective) const {
+    const int16_t *rows[32];
+    int count = 0;
+    int king_pos = position.king_index(perspective);
+    Bitboard pieces = position.occupied() & ~position.type_bb[KING];
+    while (pieces) {
+        int pos = pop_lsb(pieces);
+        rows[count++] = weights->feature_weights[feature_index(perspective, king_pos, position.piece_on(pos), pos)];
+    }
+    KERNELS[simd].update(weights->feature_biases, accumulator.values[perspective], nullptr, 0, rows, count);
+}
+
+void NnueNetwork::refresh(const Position &position, NnueAccumulator &accumulator) const {
+    refresh_perspective(position, accumulator, false);
+    refresh_perspective(position, accumulator, true);
+}
+
+void NnueNetwork::update(const NnueAccumulator &before, NnueAccumulator &after, const Position &position, const NnueDirty &dirty) const {
+    for (bool perspective : {false, true}) {
+        if (dirty.king_moved[perspective]) {
+            refresh_perspective(position, after, perspective);
+            continue;
+        }
+        int king_pos = position.king_index(perspective);
+        const int16_t *removed[2];
+        const int16_t *added[2];
+        for (int i = 0; i < dirty.removed_count; ++i) {
+            removed[i] = weights->feature_weights[feature_index(perspective, king_pos, dirty.removed_piece[i], dirty.removed_pos[i])];
+        }
+        for (int i = 0; i < dirty.added_count; ++i) {
+            added[i] = weights->feature_weights[feature_index(perspective, king_pos, dirty.added_piece[i], dirty.added_pos[i])];
+        }
+        KERNELS[simd].update(before.values[perspective], after.values[perspective], removed, dirty.removed_count, added, dirty.added_count);
+    }
+}
+
+int NnueNetwork::evaluate(const NnueAccumulator &accumulator, bool white_to_move) const {
+    const Kernels &kernels = KERNELS[simd];
+    const Weights &w = *weights;
+
+    alignas(64) uint8_t input[2 * NNUE_L1];
+    kernels.clipped_relu(accumulator.values[white_to_move], input);  // the team to move comes first
+    kernels.clipped_relu(accumulator.values[!white_to_move], input + NNUE_L1);
+
+    alignas(64) uint8_t hidden1[NNUE_L2];
+    for (int i = 0; i < NNUE_L2; ++i) {
+        hidden1[i] = uint8_t(clamp_byte((w.hidden1_biases[i] + kernels.dot(input, w.hidden1_weights[i], 2 * NNUE_L1)) >> HIDDEN_SHIFT));
+    }
+    alignas(64) uint8_t hidden2[NNUE_L3];
+    for (int i = 0; i < NNUE_L3; ++i) {
+        hidden2[i] = uint8_t(clamp_byte((w.hidden2_biases[i] + kernels.dot(hidden1, w.hidden2_weights[i], NNUE_L2)) >> HIDDEN_SHIFT));
+    }
+    return int((int64_t(w.output_bias) + kernels.dot(hidden2, w.output_weights, NNUE_L3)) / OUTPUT_SCALE);  // 64 bits so no bias can overflow
+}
+
+int NnueNetwork::evaluate(const Position &position) const {
+    NnueAccumulator accumulator;
+    refresh(position, accumulator);
+    return evaluate(accumulator, position.white_to_move);
+}
+
+NnueDirty nnue_dirty(const Position &position, Move move) {
+    NnueDirty dirty;
+    uint8_t piece = position.piece_on(move.start());
+    bool us = is_white(piece);
+    auto remove = [&dirty](uint8_t removed, int pos) {
+        dirty.removed_piece[dirty.removed_count] = removed;
+        dirty.removed_pos[dirty.removed_count++] = uint8_t(pos);
+    };
+    auto add = [&dirty](uint8_t added, int pos) {
+        dirty.added_piece[dirty.added_count] = added;
+        dirty.added_pos[dirty.added_count++] = uint8_t(pos);
+    };
+
+    if (type_of(piece) == KING) {
+        dirty.king_moved[us] = true;
+        if (move.flag() == CASTLING) {
+            std::pair<int, int> rook = castling_rook_move(move.end());
+            remove(make_piece(ROOK, us), rook.first);
+            add(make_piece(ROOK, us), rook.second);
+            return dirty;
+        }
+    } else {
+        remove(piece, move.start());
+        add(move.flag() == PROMOTION ? make_piece(move.promotion(), us) : piece, move.end());
+    }
+    int captured_pos = move.flag() == EN_PASSANT ? move.end() + (us ? 8 : -8) : move.end();
+    if (!position.is_empty(captured_pos)) {
+        remove(position.piece_on(captured_pos), captured_pos);
+    }
+    return dirty;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file nnue.h
+ * @brief Optional neural network evaluation, efficiently updated as moves are made (NNUE).
+ *
+ * The network is HalfKP shaped (see https://www.chessprogramming.org/NNUE). Its inputs are, for each team's perspective, every pair of that team's king tile with a non-king piece on a tile: 64 king tiles x 10 pieces x 64 tiles. Only about 30 inputs are ever set, and a move changes at most four of them, so the first layer's output (the accumulator, NNUE_L1 int16 values per perspective) is kept up to date by adding and subtracting a few weight rows instead of being recomputed. Only when a king moves is its team's perspective rebuilt from scratch, since every one of its inputs depends on the king's tile.
+ *
+ * The two accumulators, the side to move first, are clamped to 0..127 and fed through two small int8 layers and an int8 output layer. Black's perspective sees the board flipped top to bottom with the colours swapped, so one set of weights serves both teams.
+ *
+ * The accumulator updates and the int8 layers have AVX2, SSE4.1 and plain C++ versions. The best one the CPU supports is picked when a network is created, so the same build runs everywhere. Nothing runs on a GPU.
+ */
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "move.h"
+#include "position.h"
+#include "simd.h"
+
+/// Inputs per perspective: king tile x (5 own + 5 enemy piece types) x tile
+constexpr int NNUE_INPUTS = 64 * 10 * 64;
+/// Accumulator size per perspective
+constexpr int NNUE_L1 = 256;
+constexpr int NNUE_L2 = 32;
+constexpr int NNUE_L3 = 32;
+
+/// @brief First layer output for both perspectives of one position
+struct alignas(64) NnueAccumulator {
+    /// Indexed by [perspective team_white][neuron]
+    int16_t values[2][NNUE_L1];
+};
+
+/// @brief Inputs a move turns off and on, found before the move is made
+struct NnueDirty {
+    /// Piece codes and tiles leaving the board (the moved piece's start, a captured piece), kings are not inputs and never listed
+    uint8_t removed_piece[2];
+    uint8_t removed_pos[2];
+    int removed_count = 0;
+    /// Piece codes and tiles entering the board (the moved or promoted piece's end, a castling rook)
+    uint8_t added_piece[2];
+    uint8_t added_pos[2];
+    int added_count = 0;
+    /// Indexed by team_white, set when that team's king moves so its perspective is rebuilt
+    bool king_moved[2] = {false, false};
+};
+
+/// What making move on position changes for the network
+NnueDirty nnue_dirty(const Position &position, Move move);
+
+/// @brief Quantized network weights with evaluation and accumulator updates
+class NnueNetwork {
+   public:
+    /// All zero weights, see randomize() and load()
+    NnueNetwork();
+    ~NnueNetwork();
+
+    /**
+     * @brief Reads a network written by save(), throws std::runtime_error if the file is missing, truncated or not a network.
+     *
+     * The file is little endian: the 8 byte magic "CHESSNN1", then feature biases (int16 x NNUE_L1), feature weights (int16 x NNUE_INPUTS x NNUE_L1), the first hidden layer's biases (int32 x NNUE_L2) and weights (int8 x NNUE_L2 x 2*NNUE_L1), the second's (int32 x NNUE_L3, int8 x NNUE_L3 x NNUE_L2), and the output bias (int32) and weights (int8 x NNUE_L3).
+     */
+    static std::unique_ptr<NnueNetwork> load(const std::string &path);
+    /// Writes the weights in the format load() reads, throws std::runtime_error on failure
+    void save(const std::string &path) const;
+    /// Fills every weight with small deterministic random values, for tests and benchmarks
+    void randomize(uint64_t seed);
+
+    /// Kernels to use, lowered to best_simd_level() if the CPU can't run them
+    void set_simd_level(SimdLevel level);
+    SimdLevel simd_level() const { return simd; }
+
+    /// Builds both perspectives of accumulator from scratch
+    void refresh(const Position &position, NnueAccumulator &accumulator) const;
+    /// Builds accumulator for the position after a move from the one before it, dirty must come from nnue_dirty() before the move was made
+    void update(const NnueAccumulator &before, NnueAccumulator &after, const Position &position, const NnueDirty &dirty) const;
+    /// Score from the point of view of the team to move
+    int evaluate(const NnueAccumulator &accumulator, bool white_to_move) const;
+    /// refresh() and evaluate() in one, slow, for positions without an accumulator
+    int evaluate(const Position &position) const;
+
+   private:
+    struct Weights;
+    std::unique_ptr<Weights> weights;
+    SimdLevel simd;
+
+    void refresh_perspective(const Position &position, NnueAccumulator &accumulator, bool perspective) const;
+};
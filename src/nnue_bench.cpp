@@ -0,0 +1,107 @@
+/**
+ * @file nnue_bench.cpp
+ * @brief Measures evaluations per second of the NNUE kernels against Agent::evaluate().
+ *
+ * Walks every line a few moves deep from a handful of positions, the way a search does, and evaluates every position reached. The hand written evaluation is timed first, then the network with each kernel the CPU supports, keeping its accumulators up to date on every move like the Agent does. The network is read from the file given as the first argument, or filled with random weights when there is none; the speed doesn't depend on the weights.
+ *
+ * Usage: nnue_bench [network file] [depth]
+ */
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "agent.h"
+#include "nnue.h"
+
+namespace {
+/// Moves from the starting position to each benchmark position, as (start, end) board indices
+const std::vector<std::vector<std::pair<int, int>>> LINES = {
+    {},
+    {{52, 36}, {12, 28}, {62, 45}, {1, 18}, {61, 34}, {6, 21}},
+    {{51, 35}, {11, 27}, {50, 34}, {12, 20}, {57, 42}, {6, 21}, {58, 30}},
+    {{52, 36}, {10, 26}, {62, 45}, {11, 19}, {51, 35}, {26, 35}, {45, 35}, {6, 21}, {57, 42}, {8, 16}},
+};
+
+struct Walk {
+    Chessboard board;
+    uint64_t evaluations = 0;
+    int64_t checksum = 0;  // keeps the compiler from dropping the evaluations
+};
+
+void walk_classic(Walk &walk, Agent &agent, int depth) {
+    ++walk.evaluations;
+    walk.checksum += agent.evaluate(walk.board);
+    if (depth == 0) {
+        return;
+    }
+    for (Move move : walk.board.get_legal_moves()) {
+        walk.board.make_move(move);
+        walk_classic(walk, agent, depth - 1);
+        walk.board.unmake_move();
+    }
+}
+
+void walk_nnue(Walk &walk, const NnueNetwork &network, NnueAccumulator *stack, int depth) {
+    ++walk.evaluations;
+    walk.checksum += network.evaluate(stack[0], walk.board.white_to_move);
+    if (depth == 0) {
+        return;
+    }
+    for (Move move : walk.board.get_legal_moves()) {
+        NnueDirty dirty = nnue_dirty(walk.board, move);
+        walk.board.make_move(move);
+        network.update(stack[0], stack[1], walk.board, dirty);
+        walk_nnue(walk, network, stack + 1, depth - 1);
+        walk.board.unmake_move();
+    }
+}
+
+void report(const std::string &name, const Walk &walk, std::chrono::steady_clock::duration elapsed) {
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    std::cout << name << ": " << walk.evaluations << " evaluations in " << int(seconds * 1000) << " ms, "
+              << int(walk.evaluations / seconds) << " evals/s (checksum " << walk.checksum << ")\n";
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+    std::unique_ptr<NnueNetwork> network;
+    if (argc > 1) {
+        network = NnueNetwork::load(argv[1]);
+    } else {
+        network.reset(new NnueNetwork());
+        network->randomize(1);
+    }
+    int depth = argc > 2 ? std::atoi(argv[2]) : 3;
+
+    std::vector<Chessboard> boards;
+    for (const auto &line : LINES) {
+        boards.emplace_back();
+        for (auto [start, end] : line) {
+            boards.back().move_piece(start, end);
+        }
+    }
+
+    Agent agent{boards[0]};
+    Walk classic;
+    auto start = std::chrono::steady_clock::now();
+    for (const Chessboard &board : boards) {
+        classic.board = board;
+        walk_classic(classic, agent, depth);
+    }
+    report("evaluate()", classic, std::chrono::steady_clock::now() - start);
+
+    std::vector<NnueAccumulator> stack(depth + 1);
+    for (int level = SIMD_SCALAR; level <= best_simd_level(); ++level) {
+        network->set_simd_level(SimdLevel(level));
+        Walk nnue;
+        start = std::chrono::steady_clock::now();
+        for (const Chessboard &board : boards) {
+            nnue.board = board;
+            network->refresh(nnue.board, stack[0]);
+            walk_nnue(nnue, *network, stack.data(), depth);
+        }
+        report(std::string("nnue ") + simd_level_name(SimdLevel(level)), nnue, std::chrono::steady_clock::now() - start);
+    }
+}
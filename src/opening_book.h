@@ -0,0 +1,64 @@
+/**
+ * @file opening_book.h
+ * @brief Opening moves read from a Polyglot book instead of searched for.
+ *
+ * A Polyglot book (see http://hgm.nubati.net/book_format.html) is a file of 16 byte entries sorted by the Polyglot Zobrist key of the position they belong to: the key (8 bytes), a move (2 bytes), a weight (2 bytes) and a learn value (4 bytes, unused here), all big endian. A position with several book moves has one entry per move, next to each other. The keys are not the ones in zobrist.h: every Polyglot book uses the same fixed table of 781 random numbers, so polyglot_key() computes them separately from a Position's pieces, castling rights, en passant tile and side to move.
+ *
+ * load() maps the file into memory read only with mmap, so opening even a large book costs nothing until it is probed, and probing finds a position's entries with a binary search on the key: about 20 reads for a million entries. Moves are matched against the position's legal moves before they are returned, so a corrupt entry or a key collision can never make an illegal move.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "move.h"
+#include "position.h"
+
+/// How OpeningBook::pick() chooses between the moves a book has for a position
+enum BookSelection {
+    /// At random, each move as likely as its weight
+    BOOK_WEIGHTED,
+    /// Always the move with the highest weight
+    BOOK_BEST
+};
+
+/// @brief One legal move a book has for a position
+struct BookMove {
+    Move move;
+    /// Relative frequency, usually from how often and how well the move was played
+    uint16_t weight;
+};
+
+/// Polyglot Zobrist key of position
+uint64_t polyglot_key(const Position &position);
+
+/// @brief A Polyglot opening book, mapped into memory read only
+class OpeningBook {
+   public:
+    OpeningBook();
+    ~OpeningBook();
+
+    /// Maps the book at path into memory, replacing any loaded before, returns false if it is missing or not a whole number of entries
+    bool load(const std::string &path);
+    /// Number of entries in the book, 0 with none loaded
+    size_t size() const { return count; }
+
+    /// Every legal move the book has for position, in the order of the book
+    std::vector<BookMove> moves(const Position &position) const;
+    /// A book move for position chosen by selection, random picks the move for BOOK_WEIGHTED, the null move if the book has none
+    Move pick(const Position &position, BookSelection selection, uint64_t random = 0) const;
+
+   private:
+    const uint8_t *data = nullptr;
+    size_t count = 0;
+    /// data when read on systems without mmap
+    std::vector<uint8_t> owned;
+    void *mapping = nullptr;
+    size_t mapping_size = 0;
+
+    void unload();
+
+    OpeningBook(const OpeningBook &other) = delete;
+    OpeningBook &operator=(const OpeningBook &other) = delete;
+};
@@ -0,0 +1,97 @@
+/**
+ * @file pawn_table.cpp
+ * @brief Scores the pawn structure and remembers the result for each arrangement of pawns.
+ *
+ * A pawn is doubled when another pawn of its team stands in front of it on its column, isolated when its team has no pawns on the neighbouring columns, and passed when no pawn stands in front of it on its own column and no enemy pawn on a neighbouring one. Passed pawns earn more the further they have come, more so in the end game where nothing is left to stop them.
+ *
+ * The table is cleared to the entry for a board with no pawns, whose pawn key is 0, so an empty slot is never mistaken for a real entry.
+ */
+#include "pawn_table.h"
+
+namespace {
+constexpr PsqScore DOUBLED_PENALTY = {10, 20};
+constexpr PsqScore ISOLATED_PENALTY = {10, 15};
+/// Indexed by how many rows the pawn has moved up from its team's back row
+constexpr PsqScore PASSED_BONUS[8] = {{0, 0}, {5, 10}, {5, 15}, {10, 25}, {20, 45}, {35, 70}, {55, 110}, {0, 0}};
+
+constexpr Bitboard file_bb(int col) { return FILE_A_BB << col; }
+
+/// Columns next to col
+constexpr Bitboard adjacent_files_bb(int col) {
+    return (col > 0 ? file_bb(col - 1) : EMPTY_BB) | (col < 7 ? file_bb(col + 1) : EMPTY_BB);
+}
+
+/// Every row ahead of row for the team, white moves towards row 0
+constexpr Bitboard rows_ahead_bb(int row, bool team_white) {
+    return team_white ? (square_bb(8 * row) - 1) : row < 7 ? ~(square_bb(8 * (row + 1)) - 1) : EMPTY_BB;
+}
+
+/// One team's pawn terms, from that team's point of view
+PsqScore evaluate_team(PawnEntry &entry, Bitboard own, Bitboard enemy, bool team_white) {
+    PsqScore score{};
+    Bitboard pawns = own;
+    while (pawns) {
+        int pos = pop_lsb(pawns);
+        int row = row_of(pos);
+        int col = col_of(pos);
+
+        bool doubled = own & file_bb(col) & rows_ahead_bb(row, team_white);
+        if (doubled) {  // counted once for each pawn with a teammate in front
+            score -= DOUBLED_PENALTY;
+        }
+        if (!(own & adjacent_files_bb(col))) {
+            score -= ISOLATED_PENALTY;
+        }
+        if (!doubled && !(enemy & (file_bb(col) | adjacent_files_bb(col)) & rows_ahead_bb(row, team_white))) {
+            entry.passed[team_white] |= square_bb(pos);
+            score += PASSED_BONUS[team_white ? 7 - row : row];
+        }
+    }
+    return score;
+}
+}  // namespace
+
+PawnTable::PawnTable(int size_kb) {
+    uint64_t count = 1;
+    while (count * 2 * sizeof(PawnEntry) <= uint64_t(size_kb < 1 ? 1 : size_kb) << 10) {
+        count *= 2;
+    }
+    entries.reset(new PawnEntry[count]);
+    mask = count - 1;
+    clear();
+}
+
+void PawnTable::clear() {
+    Position empty{};
+    empty.clear_pieces();
+    PawnEntry no_pawns = evaluate(empty);
+    for (uint64_t i = 0; i <= mask; ++i) {
+        entries[i] = no_pawns;
+    }
+    hit_count = miss_count = 0;
+}
+
+const PawnEntry &PawnTable::probe(const Position &position) {
+    PawnEntry &entry = entries[position.pawn_key & mask];
+    if (entry.pawn_key == position.pawn_key) {
+        ++hit_count;
+        return entry;
+    }
+    ++miss_count;
+    entry = evaluate(position);
+    return entry;
+}
+
+PawnEntry PawnTable::evaluate(const Position &position) {
+    PawnEntry entry{};
+    entry.pawn_key = position.pawn_key;
+    Bitboard white = position.pieces(true, PAWN);
+    Bitboard black = position.pieces(false, PAWN);
+    entry.score = evaluate_team(entry, black, white, false) - evaluate_team(entry, white, black, true);  // black's point of view
+    for (int col = 0; col < 8; ++col) {
+        entry.open_files |= !((white | black) & file_bb(col)) << col;
+        entry.semi_open_files[true] |= !(white & file_bb(col)) << col;
+        entry.semi_open_files[false] |= !(black & file_bb(col)) << col;
+    }
+    return entry;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file pawn_table.h
+ * @brief Scores the pawn structure and remembers the result for each arrangement of pawns.
+ *
+ * Doubled, isolated and passed pawns are worth scoring, but looking for them means walking every pawn and comparing it with the pawns on its own and neighbouring columns. Pawns only move or disappear in a small fraction of moves, so the same arrangement of pawns comes up again and again during a search. The PawnTable is a small hash table keyed by Position::pawn_key, a Zobrist key of the pawns alone, holding the pawn score and what was learned along the way (the passed pawns and the open columns) so the evaluation can reuse them for pieces too (see https://www.chessprogramming.org/Pawn_Hash_Table).
+ *
+ * Each Agent owns its own table, so it is read and written without any locking.
+ */
+#pragma once
+#include <cstdint>
+#include <memory>
+
+#include "bitboard.h"
+#include "position.h"
+#include "psqt.h"
+
+/// @brief Everything learned about one arrangement of pawns
+struct PawnEntry {
+    uint64_t pawn_key;
+    /// Doubled, isolated and passed pawns from black's point of view, like the rest of the evaluation
+    PsqScore score;
+    /// Pawns with no pawn in front of them on their own column and no enemy pawn in front of them on a neighbouring column, indexed by team_white
+    Bitboard passed[2];
+    /// Bit per column with no pawns at all
+    uint8_t open_files;
+    /// Bit per column with no pawn of the team, indexed by team_white
+    uint8_t semi_open_files[2];
+};
+
+/// @brief Fixed size hash table of PawnEntry, with hit statistics
+class PawnTable {
+   public:
+    explicit PawnTable(int size_kb = 512);
+
+    /// Forgets every entry and resets the statistics
+    void clear();
+    /// Entry for the position's pawns, scored and stored first if the table doesn't have it
+    const PawnEntry &probe(const Position &position);
+
+    uint64_t hits() const { return hit_count; }
+    uint64_t misses() const { return miss_count; }
+    /// Share of probes answered from the table, in permille
+    int hit_rate() const { return hit_count + miss_count ? int(hit_count * 1000 / (hit_count + miss_count)) : 0; }
+
+    /// Scores the pawn structure from scratch
+    static PawnEntry evaluate(const Position &position);
+
+   private:
+    std::unique_ptr<PawnEntry[]> entries;
+    uint64_t mask;
+    uint64_t hit_count = 0;
+    uint64_t miss_count = 0;
+};
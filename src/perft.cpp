@@ -0,0 +1,118 @@
+/**
+ * @file perft.cpp
+ * @brief Counts every line of play to a fixed depth, to check the move generator against known counts and to time it.
+ *
+ * The depth is part of a PerftHash entry's index as well as its data, so the counts of one position to different depths land in different entries instead of pushing each other out.
+ */
+#include "perft.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace {
+constexpr uint64_t COUNT_MASK = (uint64_t(1) << 56) - 1;
+
+uint64_t pack(uint64_t count, int depth) { return count << 8 | uint8_t(depth); }
+}  // namespace
+
+PerftHash::PerftHash(size_t size_mb) {
+    size_t count = std::max<size_t>(size_mb, 1) * 1024 * 1024 / sizeof(Slot);
+    size_t size = 1;
+    while (size * 2 <= count) {
+        size *= 2;
+    }
+    slots.reset(new Slot[size]);
+    mask = size - 1;
+    for (size_t i = 0; i < size; ++i) {
+        slots[i].key_xor_data.store(0, std::memory_order_relaxed);
+        slots[i].data.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t PerftHash::index(uint64_t key, int depth) const {
+    return (key ^ uint64_t(depth) * 0x9E3779B97F4A7C15ull) & mask;
+}
+
+bool PerftHash::probe(uint64_t key, int depth, uint64_t &count) const {
+    const Slot &slot = slots[index(key, depth)];
+    uint64_t data = slot.data.load(std::memory_order_relaxed);
+    if ((slot.key_xor_data.load(std::memory_order_relaxed) ^ data) != key || uint8_t(data) != depth) {
+        return false;
+    }
+    count = data >> 8;
+    return true;
+}
+
+void PerftHash::store(uint64_t key, int depth, uint64_t count) {
+    if (count > COUNT_MASK) {
+        return;
+    }
+    Slot &slot = slots[index(key, depth)];
+    uint64_t data = pack(count, depth);
+    slot.key_xor_data.store(key ^ data, std::memory_order_relaxed);
+    slot.data.store(data, std::memory_order_relaxed);
+}
+
+uint64_t perft(Chessboard &board, int depth, PerftHash *hash) {
+    if (depth == 0) {
+        return 1;
+    }
+    MoveList moves;
+    generate_legal_moves(board, moves);
+    if (depth == 1) {
+        return moves.size();
+    }
+    uint64_t count;
+    if (hash && hash->probe(board.key, depth, count)) {
+        return count;
+    }
+    count = 0;
+    for (Move move : moves) {
+        board.make_move(move);
+        count += perft(board, depth - 1, hash);
+        board.unmake_move();
+    }
+    if (hash) {
+        hash->store(board.key, depth, count);
+    }
+    return count;
+}
+
+PerftResult perft_divide(const Chessboard &board, int depth, int threads, PerftHash *hash) {
+    auto start_time = std::chrono::steady_clock::now();
+    PerftResult result;
+    if (depth <= 0) {
+        result.nodes = 1;
+        return result;
+    }
+    MoveList moves = board.get_legal_moves();
+    for (Move move : moves) {
+        result.divide.emplace_back(move, 0);
+    }
+
+    // each thread takes the next root move nobody has started, so one slow move doesn't hold up the others
+    std::atomic<size_t> next{0};
+    auto work = [&] {
+        Chessboard copy = board;
+        for (size_t i = next++; i < result.divide.size(); i = next++) {
+            copy.make_move(result.divide[i].first);
+            result.divide[i].second = perft(copy, depth - 1, hash);
+            copy.unmake_move();
+        }
+    };
+    std::vector<std::thread> helpers;
+    for (int t = 1; t < std::min<int>(threads, int(moves.size())); ++t) {
+        helpers.emplace_back(work);
+    }
+    work();
+    for (std::thread &helper : helpers) {
+        helper.join();
+    }
+
+    for (const auto &[move, count] : result.divide) {
+        result.nodes += count;
+    }
+    result.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+    return result;
+}
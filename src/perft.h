@@ -0,0 +1,57 @@
+/**
+ * @file perft.h
+ * @brief Counts every line of play to a fixed depth, to check the move generator against known counts and to time it.
+ *
+ * Perft (see https://www.chessprogramming.org/Perft) makes every legal move to the given depth and counts the positions at the end. The counts for well known positions have been verified by many engines, so any difference points at a move generation bug, and the "divide" counts under each root move show which move it is under. Positions one move from the end are counted by the number of moves generated for them without making any of them.
+ *
+ * perft_divide() splits the root moves between threads, each taking the next root move not yet counted on its own copy of the board. With a PerftHash, positions reached again through a different order of moves are looked up by Zobrist key and depth instead of counted again, which makes deep counts many times faster. The table is shared by every thread without locks, each entry stored as two words with the key XORed into one of them like the TranspositionTable, so a torn entry never gives a wrong count.
+ */
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "chessboard.h"
+
+/// @brief Leaf counts keyed by Zobrist key and depth, shared by every perft thread without locks
+class PerftHash {
+   public:
+    /// Allocates the largest power of two number of entries fitting in size_mb (at least 1)
+    explicit PerftHash(size_t size_mb = 64);
+
+    /// Sets count and returns true if the count of key's position to depth is stored
+    bool probe(uint64_t key, int depth, uint64_t &count) const;
+    /// Stores the count of key's position to depth, replacing whatever was in its entry
+    void store(uint64_t key, int depth, uint64_t count);
+
+   private:
+    /// data is the count (56 bits) and the depth (8 bits)
+    struct Slot {
+        std::atomic<uint64_t> key_xor_data;
+        std::atomic<uint64_t> data;
+    };
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+
+    size_t index(uint64_t key, int depth) const;
+
+    PerftHash(const PerftHash &other) = delete;
+    PerftHash &operator=(const PerftHash &other) = delete;
+};
+
+/// Leaf nodes depth moves ahead of board, looking positions up in hash if it isn't nullptr; board is left as it was
+uint64_t perft(Chessboard &board, int depth, PerftHash *hash = nullptr);
+
+/// @brief Outcome of perft_divide()
+struct PerftResult {
+    uint64_t nodes = 0;
+    /// Leaf nodes under each root move, in the order the moves were generated
+    std::vector<std::pair<Move, uint64_t>> divide;
+    int64_t time_ms = 0;
+};
+
+/// perft() of every root move of board, the moves split between threads threads, the calling thread included
+PerftResult perft_divide(const Chessboard &board, int depth, int threads = 1, PerftHash *hash = nullptr);
@@ -0,0 +1,51 @@
+/**
+ * @file perft_main.cpp
+ * @brief Prints the perft count of a position under each root move, then the total and the speed (see perft.h).
+ *
+ * The root moves are split between the given number of threads. With hash_mb above 0, counts already found are kept in a PerftHash of that size; the totals are the same either way, only faster. The position is the starting one unless a FEN record is given, as the remaining arguments.
+ *
+ * Usage: perft <depth> [threads] [hash_mb] [fen]
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "perft.h"
+#include "uci.h"
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: perft <depth> [threads] [hash_mb] [fen]\n";
+        return 1;
+    }
+    int depth = std::clamp(std::atoi(argv[1]), 0, 255);
+    int threads = argc > 2 ? std::max(1, std::atoi(argv[2])) : 1;
+    int hash_mb = argc > 3 ? std::max(0, std::atoi(argv[3])) : 0;
+    std::string fen;
+    for (int i = 4; i < argc; ++i) {
+        fen += std::string(argv[i]) + " ";
+    }
+
+    Chessboard board;
+    if (!fen.empty()) {
+        try {
+            board.set_fen(fen);
+        } catch (const FenError &error) {
+            std::cerr << "perft: invalid fen: " << error.what() << "\n";
+            return 1;
+        }
+    }
+    std::unique_ptr<PerftHash> hash;
+    if (hash_mb > 0) {
+        hash.reset(new PerftHash(hash_mb));
+    }
+
+    PerftResult result = perft_divide(board, depth, threads, hash.get());
+    for (const auto &[move, count] : result.divide) {
+        std::cout << move_to_uci(move) << ": " << count << "\n";
+    }
+    std::cout << "nodes " << result.nodes << ", " << result.time_ms << " ms, "
+              << result.nodes * 1000 / uint64_t(std::max<int64_t>(result.time_ms, 1)) << " nodes/s\n";
+}
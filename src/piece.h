@@ -2,21 +2,14 @@
  * @file piece.h
  * @brief Finds possible moves given a Piece.
  *
- * The Piece class is used to store data like the pos and type of each piece. It is also used to find the possible moves for a piece. Each piece has a different function for this, and the pointers to these functions are stored in a vector to allow for constant time lookup.
+ * The Piece class is used to store data like the pos and type of each piece. It is also used to find the possible moves for a piece. The moves of each Type are looked up in the attack tables from bitboard.h by a switch on the piece's type, so a Piece is a plain value with no per-piece tables to copy and the compiler can inline each lookup.
  */
 #pragma once
-#include <SDL2/SDL.h>
-#include <SDL_image.h>
-
+#include <cstdint>
 #include <optional>
-#include <string>
 #include <vector>
 
-class Chessboard;
-class Piece;
-
-/// @brief Simplifies function pointer syntax for functions filling a vector possible_moves
-using FuncPtr = void (*)(const Piece &piece, std::vector<int> &possible_moves, const Chessboard &chessboard);
+struct Position;
 
 enum Type {
     PAWN,
@@ -31,27 +24,13 @@ enum Type {
 class Piece {
    public:
     Piece(int pos, Type type, bool team_white);
-    Piece(const Piece &other);
-    Piece &operator=(const Piece &other);
-    Piece(Piece &&other) noexcept;
-    Piece &operator=(Piece &&other) noexcept;
-    /// Returns possible moves for one piece
-    std::vector<int> get_possible_moves(const Chessboard &chessboard);
+    /// Returns possible moves for one piece, ignoring checks, castling and en passant
+    std::vector<int> get_possible_moves(const Position &position) const;
+    /// Same tiles as get_possible_moves() as a Bitboard, never allocates
+    uint64_t get_possible_moves_bb(const Position &position) const;
     bool is_opposing_team(std::optional<Piece> other) const;
 
     int pos;
     Type type;
     bool team_white;
-
-   private:
-    /// Vector of functions that have corresponding possible_move functions, ordered to allow constant time lookups (see piece.h)
-    std::vector<FuncPtr> find_move_functions;
 };
-void test_pawn(const Piece &piece, std::vector<int> &possible_moves, const Chessboard &chessboard);
-void test_white_pawn(const Piece &piece, std::vector<int> &possible_moves, const Chessboard &chessboard);
-void test_black_pawn(const Piece &piece, std::vector<int> &possible_moves, const Chessboard &chessboard);
-void test_rook(const Piece &piece, std::vector<int> &possible_moves, const Chessboard &chessboard);
-void test_bishop(const Piece &piece, std::vector<int> &possible_moves, const Chessboard &chessboard);
-void test_knight(const Piece &piece, std::vector<int> &possible_moves, const Chessboard &chessboard);
-void test_queen(const Piece &piece, std::vector<int> &possible_moves, const Chessboard &chessboard);
-void test_king(const Piece &piece, std::vector<int> &possible_moves, const Chessboard &chessboard);
\ No newline at end of file
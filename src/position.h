@@ -0,0 +1,199 @@
+/**
+ * @file position.h
+ * @brief Compact bitboard representation of a game state.
+ *
+ * The Position struct stores a game state as one Bitboard per piece Type, one Bitboard per team, and a 64 byte mailbox that answers "what is on this tile" in constant time. It holds no pointers or containers, so copying a Position is a plain copy of a few cache lines with no heap allocations. The Chessboard builds its rules on top of a Position, and the Agent can snapshot one whenever it needs to.
+ */
+#pragma once
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "bitboard.h"
+#include "piece.h"
+#include "psqt.h"
+#include "zobrist.h"
+
+/// Bits of Position::castling_rights
+enum CastlingRight : uint8_t {
+    W_KING_SIDE = 1,
+    W_QUEEN_SIDE = 2,
+    B_KING_SIDE = 4,
+    B_QUEEN_SIDE = 8,
+    ALL_CASTLING = 15
+};
+
+/// Rook start and end tiles for a castling move, found from where the king lands
+inline std::pair<int, int> castling_rook_move(int king_end) {
+    switch (king_end) {
+        case 62:
+            return {63, 61};
+        case 58:
+            return {56, 59};
+        case 6:
+            return {7, 5};
+        default:
+            return {0, 3};
+    }
+}
+
+/// Mailbox value of an empty tile
+constexpr uint8_t NO_PIECE = 12;
+
+/// Piece codes are ordered the same way as the Graphics textures and Agent piece structures: type + team_white * 6
+constexpr uint8_t make_piece(Type type, bool team_white) { return type + team_white * 6; }
+constexpr Type type_of(uint8_t piece) { return Type(piece % 6); }
+constexpr bool is_white(uint8_t piece) { return piece >= 6; }
+
+/// @brief Bitboard game state, trivially copyable
+struct Position {
+    /// Every piece of each Type, both teams
+    Bitboard type_bb[6];
+    /// Every piece of each team, indexed by team_white
+    Bitboard team_bb[2];
+    /// Piece code on each tile, NO_PIECE when empty
+    uint8_t mailbox[64];
+    /// True: white's turn | False: black's turn
+    bool white_to_move;
+    /// Store for a fast way to test for checks/mate
+    int8_t w_king_index;
+    /// Store for a fast way to test for checks/mate
+    int8_t b_king_index;
+    int8_t w_num_pieces;
+    int8_t b_num_pieces;
+    /// CastlingRight bits still available to each team
+    uint8_t castling_rights;
+    /// Tile a pawn skipped over with a two tile move last turn, -1 if there is none or no enemy pawn can capture on it
+    int8_t ep_index;
+    /// Zobrist key of the game state (see zobrist.h), pieces are kept up to date here and the rest by whoever changes them
+    uint64_t key;
+    /// Zobrist key of the pawns alone, for the PawnTable, kept up to date here
+    uint64_t pawn_key;
+    /// Material and piece-square score of every piece from black's point of view (see psqt.h), kept up to date here
+    PsqScore psq;
+
+    Bitboard occupied() const { return team_bb[0] | team_bb[1]; }
+    Bitboard pieces(bool team_white) const { return team_bb[team_white]; }
+    Bitboard pieces(bool team_white, Type type) const { return team_bb[team_white] & type_bb[type]; }
+    uint8_t piece_on(int pos) const { return mailbox[pos]; }
+    bool is_empty(int pos) const { return mailbox[pos] == NO_PIECE; }
+    int king_index(bool team_white) const { return team_white ? w_king_index : b_king_index; }
+
+    /// Removes every piece from the board
+    void clear_pieces();
+    /// Places a piece on an empty tile, keeping bitboards, king indices and piece counts in sync
+    void put_piece(int pos, Type type, bool team_white);
+    /// Removes the piece on an occupied tile
+    void remove_piece(int pos);
+    /// Moves the piece on start to the empty tile end
+    void relocate_piece(int start, int end);
+    /// Zobrist key built from scratch, key should always equal it
+    uint64_t compute_key() const;
+    /// pawn_key built from scratch, pawn_key should always equal it
+    uint64_t compute_pawn_key() const;
+    /// psq built from scratch, psq should always equal it
+    PsqScore compute_psq() const;
+    /// How far from the end game the material left puts the game, MAX_PHASE at the start down to 0 with only kings and pawns
+    int game_phase() const;
+};
+
+static_assert(std::is_trivially_copyable<Position>::value, "Position must stay a plain copyable value");
+static_assert(sizeof(Position) <= 192, "Position should fit in three cache lines");
+
+inline void Position::clear_pieces() {
+    for (Bitboard &b : type_bb) {
+        b = EMPTY_BB;
+    }
+    team_bb[0] = team_bb[1] = EMPTY_BB;
+    for (uint8_t &p : mailbox) {
+        p = NO_PIECE;
+    }
+    w_king_index = b_king_index = -1;
+    w_num_pieces = b_num_pieces = 0;
+    castling_rights = 0;
+    ep_index = -1;
+    key = 0;
+    pawn_key = 0;
+    psq = PsqScore{};
+}
+
+inline void Position::put_piece(int pos, Type type, bool team_white) {
+    type_bb[type] |= square_bb(pos);
+    team_bb[team_white] |= square_bb(pos);
+    mailbox[pos] = make_piece(type, team_white);
+    key ^= piece_key(mailbox[pos], pos);
+    psq += psq_score(mailbox[pos], pos);
+    if (type == PAWN) {
+        pawn_key ^= piece_key(mailbox[pos], pos);
+    } else if (type == KING) {
+        (team_white ? w_king_index : b_king_index) = pos;
+    }
+    ++(team_white ? w_num_pieces : b_num_pieces);
+}
+
+inline void Position::remove_piece(int pos) {
+    uint8_t piece = mailbox[pos];
+    type_bb[type_of(piece)] &= ~square_bb(pos);
+    team_bb[is_white(piece)] &= ~square_bb(pos);
+    mailbox[pos] = NO_PIECE;
+    key ^= piece_key(piece, pos);
+    psq -= psq_score(piece, pos);
+    if (type_of(piece) == PAWN) {
+        pawn_key ^= piece_key(piece, pos);
+    }
+    --(is_white(piece) ? w_num_pieces : b_num_pieces);
+}
+
+inline void Position::relocate_piece(int start, int end) {
+    uint8_t piece = mailbox[start];
+    Bitboard start_end = square_bb(start) | square_bb(end);
+    type_bb[type_of(piece)] ^= start_end;
+    team_bb[is_white(piece)] ^= start_end;
+    mailbox[start] = NO_PIECE;
+    mailbox[end] = piece;
+    key ^= piece_key(piece, start) ^ piece_key(piece, end);
+    psq += psq_score(piece, end) - psq_score(piece, start);
+    if (type_of(piece) == PAWN) {
+        pawn_key ^= piece_key(piece, start) ^ piece_key(piece, end);
+    } else if (type_of(piece) == KING) {
+        (is_white(piece) ? w_king_index : b_king_index) = end;
+    }
+}
+
+inline uint64_t Position::compute_key() const {
+    uint64_t k = side_key(white_to_move) ^ castling_key(castling_rights) ^ ep_key(ep_index);
+    Bitboard occupied_bb = occupied();
+    while (occupied_bb) {
+        int pos = pop_lsb(occupied_bb);
+        k ^= piece_key(mailbox[pos], pos);
+    }
+    return k;
+}
+
+inline uint64_t Position::compute_pawn_key() const {
+    uint64_t k = 0;
+    Bitboard pawns = type_bb[PAWN];
+    while (pawns) {
+        int pos = pop_lsb(pawns);
+        k ^= piece_key(mailbox[pos], pos);
+    }
+    return k;
+}
+
+inline PsqScore Position::compute_psq() const {
+    PsqScore score{};
+    Bitboard occupied_bb = occupied();
+    while (occupied_bb) {
+        int pos = pop_lsb(occupied_bb);
+        score += psq_score(mailbox[pos], pos);
+    }
+    return score;
+}
+
+inline int Position::game_phase() const {
+    int phase = 0;
+    for (Type type : {KNIGHT, BISHOP, ROOK, QUEEN}) {
+        phase += PHASE_WEIGHTS[type] * popcount(type_bb[type]);
+    }
+    return phase < MAX_PHASE ? phase : MAX_PHASE;  // promotions can push it past the start
+}
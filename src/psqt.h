@@ -0,0 +1,143 @@
+/**
+ * @file psqt.h
+ * @brief Material values and middle/end game piece-square tables, combined into one score per piece and tile.
+ *
+ * A piece's contribution to the evaluation from its material value and the tile it stands on ([Piece-Square Tables](https://www.chessprogramming.org/Piece-Square_Tables)) depends on nothing but the piece and its tile. Both are folded into one table at compile time, signed from black's point of view like Agent::evaluate(). The Position adds and subtracts entries as pieces are put, removed and moved, so the sum over the whole board is always at hand and the evaluation never has to loop over the board for it.
+ *
+ * Every entry holds two scores, one for the middle game and one for the end game. The evaluation blends them by the game phase, worked out from the knights, bishops, rooks and queens left on the board ([Tapered Eval](https://www.chessprogramming.org/Tapered_Eval)), so the king moves from hiding behind its pawns to the centre gradually as material comes off instead of jumping between tables at a fixed piece count.
+ *
+ * Only white's tables are written out, with index 0 as a8 like the board. Black's are white's flipped top to bottom, generated along with the combined table.
+ */
+#pragma once
+#include <cstdint>
+
+#include "piece.h"
+
+/// @brief A middle game and an end game score, blended by taper()
+struct PsqScore {
+    int32_t mg;
+    int32_t eg;
+
+    constexpr PsqScore &operator+=(PsqScore other) {
+        mg += other.mg;
+        eg += other.eg;
+        return *this;
+    }
+    constexpr PsqScore &operator-=(PsqScore other) {
+        mg -= other.mg;
+        eg -= other.eg;
+        return *this;
+    }
+    constexpr PsqScore operator+(PsqScore other) const { return PsqScore{*this} += other; }
+    constexpr PsqScore operator-(PsqScore other) const { return PsqScore{*this} -= other; }
+    constexpr PsqScore operator-() const { return PsqScore{-mg, -eg}; }
+    constexpr bool operator==(PsqScore other) const { return mg == other.mg && eg == other.eg; }
+    constexpr bool operator!=(PsqScore other) const { return !(*this == other); }
+};
+
+/// Material value of each Type, indexed by Type
+inline constexpr int PIECE_VALUES[6] = {100, 310, 320, 500, 1500, 900};
+
+/// Game phase each Type is worth, pawns and kings never leave the board in a way that says much about the phase
+inline constexpr int PHASE_WEIGHTS[6] = {0, 1, 1, 2, 0, 4};
+/// Phase of the starting position, where the middle game scores are used alone, 0 is a bare end game
+inline constexpr int MAX_PHASE = 24;
+
+/// Bonus for a white piece standing on each tile in the middle game, indexed by [Type][pos]
+inline constexpr int MG_BONUS[6][64] = {
+    {  // pawn
+        0, 0, 0, 0, 0, 0, 0, 0,
+        50, 50, 50, 50, 50, 50, 50, 50,
+        10, 10, 20, 30, 30, 20, 10, 10,
+        5, 5, 10, 25, 25, 10, 5, 5,
+        0, 0, 0, 20, 20, 0, 0, 0,
+        5, -5, -10, 0, 0, -10, -5, 5,
+        5, 10, 10, -20, -20, 10, 10, 5,
+        0, 0, 0, 0, 0, 0, 0, 0},
+    {  // knight
+        -50, -40, -30, -30, -30, -30, -40, -50,
+        -40, -20, 0, 0, 0, 0, -20, -40,
+        -30, 0, 10, 15, 15, 10, 0, -30,
+        -30, 5, 15, 20, 20, 15, 5, -30,
+        -30, 0, 15, 20, 20, 15, 0, -30,
+        -30, 5, 10, 15, 15, 10, 5, -30,
+        -40, -20, 0, 5, 5, 0, -20, -40,
+        -50, -40, -30, -30, -30, -30, -40, -50},
+    {  // bishop
+        -20, -10, -10, -10, -10, -10, -10, -20,
+        -10, 0, 0, 0, 0, 0, 0, -10,
+        -10, 0, 5, 10, 10, 5, 0, -10,
+        -10, 5, 5, 10, 10, 5, 5, -10,
+        -10, 0, 10, 10, 10, 10, 0, -10,
+        -10, 10, 10, 10, 10, 10, 10, -10,
+        -10, 5, 0, 0, 0, 0, 5, -10,
+        -20, -10, -10, -10, -10, -10, -10, -20},
+    {  // rook
+        0, 0, 0, 0, 0, 0, 0, 0,
+        5, 10, 10, 10, 10, 10, 10, 5,
+        -5, 0, 0, 0, 0, 0, 0, -5,
+        -5, 0, 0, 0, 0, 0, 0, -5,
+        -5, 0, 0, 0, 0, 0, 0, -5,
+        -5, 0, 0, 0, 0, 0, 0, -5,
+        -5, 0, 0, 0, 0, 0, 0, -5,
+        0, 0, 0, 5, 5, 0, 0, 0},
+    {  // king
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -20, -30, -30, -40, -40, -30, -30, -20,
+        -10, -20, -20, -20, -20, -20, -20, -10,
+        20, 20, 0, 0, 0, 0, 20, 20,
+        20, 30, 10, 0, 0, 10, 30, 20},
+    {  // queen
+        -20, -10, -10, -5, -5, -10, -10, -20,
+        -10, 0, 0, 0, 0, 0, 0, -10,
+        -10, 0, 5, 5, 5, 5, 0, -10,
+        -5, 0, 5, 5, 5, 5, 0, -5,
+        0, 0, 5, 5, 5, 5, 0, -5,
+        -10, 5, 5, 5, 5, 5, 0, -10,
+        -10, 0, 5, 0, 0, 0, 0, -10,
+        -20, -10, -10, -5, -5, -10, -10, -20},
+};
+
+/// Bonus for a white king standing on each tile in the end game, it should come to the centre and help its pawns
+inline constexpr int EG_KING_BONUS[64] = {
+    -50, -40, -30, -20, -20, -30, -40, -50,
+    -30, -20, -10, 0, 0, -10, -20, -30,
+    -30, -10, 20, 30, 30, 20, -10, -30,
+    -30, -10, 30, 40, 40, 30, -10, -30,
+    -30, -10, 30, 40, 40, 30, -10, -30,
+    -30, -10, 20, 30, 30, 20, -10, -30,
+    -30, -30, 0, 0, 0, 0, -30, -30,
+    -50, -30, -30, -30, -30, -30, -30, -50};
+
+/// @brief Material plus piece-square bonus for every piece code on every tile
+struct PsqTable {
+    PsqScore scores[12][64];
+};
+
+constexpr PsqTable make_psq_table() {
+    PsqTable table{};
+    for (int piece = 0; piece < 12; ++piece) {
+        int type = piece % 6;
+        bool team_white = piece >= 6;
+        for (int pos = 0; pos < 64; ++pos) {
+            int white_pos = team_white ? pos : pos ^ 56;  // black's tables are white's flipped top to bottom
+            int mg = PIECE_VALUES[type] + MG_BONUS[type][white_pos];
+            int eg = PIECE_VALUES[type] + (type == KING ? EG_KING_BONUS[white_pos] : MG_BONUS[type][white_pos]);
+            table.scores[piece][pos] = team_white ? PsqScore{-mg, -eg} : PsqScore{mg, eg};  // black's point of view
+        }
+    }
+    return table;
+}
+
+inline constexpr PsqTable PSQ_TABLE = make_psq_table();
+
+/// What a piece on pos adds to Position::psq
+inline PsqScore psq_score(uint8_t piece, int pos) { return PSQ_TABLE.scores[piece][pos]; }
+
+/// Blends a score by the game phase (0 to MAX_PHASE), linear between the end game and middle game scores
+constexpr int taper(PsqScore score, int phase) {
+    return (score.mg * phase + score.eg * (MAX_PHASE - phase)) / MAX_PHASE;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file see.cpp
+ * @brief Static exchange evaluation: what a capture wins once every recapture on its tile is played out.
+ *
+ * This is the "swap" algorithm: gain[d] holds what the side making the d-th capture has won if the exchange stopped right after it. The list is then folded back from the end, letting each side choose between recapturing and stopping.
+ */
+#include "see.h"
+
+#include <algorithm>
+
+#include "movegen.h"
+
+int static_exchange(const Position &position, Move move) {
+    if (move.flag() == CASTLING) {
+        return 0;
+    }
+    int end = move.end();
+    Bitboard occupied = position.occupied() ^ square_bb(move.start());
+    int gain[32];
+    int d = 0;
+
+    if (move.flag() == EN_PASSANT) {
+        gain[0] = SEE_VALUES[PAWN];
+        occupied ^= square_bb(end + (position.white_to_move ? 8 : -8));
+    } else {
+        gain[0] = position.is_empty(end) ? 0 : SEE_VALUES[type_of(position.piece_on(end))];
+    }
+    // value of the piece now standing on end, the next one to be captured
+    int on_end = SEE_VALUES[type_of(position.piece_on(move.start()))];
+    if (move.flag() == PROMOTION) {
+        gain[0] += SEE_VALUES[move.promotion()] - SEE_VALUES[PAWN];
+        on_end = SEE_VALUES[move.promotion()];
+    }
+
+    bool side = !position.white_to_move;
+    Bitboard attackers = attackers_to(position, end, occupied) & occupied;
+    while (d < 31) {
+        ++d;
+        gain[d] = on_end - gain[d - 1];  // what side wins if it captures and the exchange stops there
+        if (std::max(-gain[d - 1], gain[d]) < 0) {
+            break;  // neither capturing nor stopping changes the sign, the rest can't matter
+        }
+        Bitboard side_attackers = attackers & position.pieces(side);
+        if (!side_attackers) {
+            break;
+        }
+        // recapture with the least valuable piece
+        Type type = PAWN;
+        for (Type t : {PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING}) {
+            if (side_attackers & position.type_bb[t]) {
+                type = t;
+                break;
+            }
+        }
+        occupied ^= square_bb(lsb(side_attackers & position.type_bb[type]));
+        attackers = attackers_to(position, end, occupied) & occupied;  // sliders behind the recapturing piece join in
+        on_end = SEE_VALUES[type];
+        side = !side;
+    }
+    // the last entry is a capture nobody could make, fold the rest back letting each side stop when that is better
+    while (--d) {
+        gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+    }
+    return gain[0];
+}
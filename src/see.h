@@ -0,0 +1,15 @@
+/**
+ * @file see.h
+ * @brief Static exchange evaluation: what a capture wins once every recapture on its tile is played out.
+ *
+ * A capture that looks good on its own can lose material if the captured piece was defended. static_exchange() plays out the sequence of captures on the move's end tile, each side always recapturing with its least valuable piece and stopping whenever recapturing would lose more than it gains, without making a single move on the board (see https://www.chessprogramming.org/Static_Exchange_Evaluation). Sliders hidden behind a piece that takes part in the exchange join in once that piece has moved. Pins are ignored, so the result is an estimate, but a cheap one the search can call on every capture.
+ */
+#pragma once
+#include "move.h"
+#include "position.h"
+
+/// Material values used by the exchange, the king is large enough that it never recaptures into a defended tile
+constexpr int SEE_VALUES[6] = {100, 320, 330, 500, 20000, 900};
+
+/// Material the team to move wins (negative if it loses) by playing move and the best recaptures that follow
+int static_exchange(const Position &position, Move move);
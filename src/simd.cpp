@@ -0,0 +1,29 @@
+/**
+ * @file simd.cpp
+ * @brief Which vector instruction sets the running CPU supports.
+ */
+#include "simd.h"
+
+SimdLevel best_simd_level() {
+#ifdef CHESS_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SIMD_AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return SIMD_SSE41;
+    }
+#endif
+    return SIMD_SCALAR;
+}
+
+const char *simd_level_name(SimdLevel level) {
+    switch (level) {
+        case SIMD_AVX2:
+            return "avx2";
+        case SIMD_SSE41:
+            return "sse4.1";
+        default:
+            return "scalar";
+    }
+}
@@ -0,0 +1,24 @@
+/**
+ * @file simd.h
+ * @brief Which vector instruction sets the running CPU supports.
+ *
+ * The kernels in nnue.cpp and batch_eval.cpp are compiled for several instruction sets with GCC's target attribute, so one build runs on any x86-64 CPU. best_simd_level() is asked once at runtime which of them this CPU can run, the same way bitboard.cpp decides whether to use PEXT.
+ */
+#pragma once
+#include <cstdint>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+/// Defined when the x86 kernels are compiled in
+#define CHESS_SIMD_X86 1
+#endif
+
+/// Instruction sets the vector kernels are written for, in order of speed
+enum SimdLevel : uint8_t {
+    SIMD_SCALAR,
+    SIMD_SSE41,
+    SIMD_AVX2
+};
+
+/// Fastest SimdLevel this CPU supports
+SimdLevel best_simd_level();
+const char *simd_level_name(SimdLevel level);
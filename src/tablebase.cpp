@@ -0,0 +1,701 @@
+/**
+ * @file tablebase.cpp
+ * @brief Perfect play for every game state with few pieces left, from endgame tables built ahead of time.
+ *
+ * Retrograde analysis works ply by ply. Before the first ply, every position gets the number of different positions its quiet moves lead to in the same table, and captures and promotions are looked up in the smaller tables straight away. At ply n, every position found lost n - 1 plies from mate makes each position one move before it a win in n plies, found by taking a move back instead of making one. Every position found won n - 1 plies from mate takes one off the count of each position before it, and a position whose count reaches zero (and whose captures and promotions lose too) is lost in n plies. The positions of each ply are split between threads; the counts and distances of the positions before them are changed with atomic operations, since two threads can reach the same one.
+ *
+ * Every position is stored once per symmetry of the board, so one and the same position must always get the same index, whichever tiles it was reached on: it is moved to the stored part of the board with a symmetry that depends only on the white king's tile, and when two symmetries both put that king in the stored part, the smaller index is used.
+ */
+#include "tablebase.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "movegen.h"
+
+namespace {
+constexpr char MAGIC[8] = {'C', 'H', 'E', 'S', 'S', 'T', 'B', '1'};
+constexpr size_t HEADER_SIZE = 16;
+
+/// Stored bytes: CODE_DRAW, a win in 2 * code - 1 plies below CODE_LOSS, a loss in 2 * (code - CODE_LOSS) plies from it
+constexpr uint8_t CODE_DRAW = 0;
+constexpr uint8_t CODE_LOSS = 128;
+/// Stored for indices that aren't a legal position, never read by probe()
+constexpr uint8_t CODE_ILLEGAL = 255;
+/// Longest distance to mate a code can hold
+constexpr int MAX_PLIES = 253;
+
+/// Non-king piece types, strongest first, the order each team's pieces take in a table
+constexpr Type TABLE_TYPES[5] = {QUEEN, ROOK, BISHOP, KNIGHT, PAWN};
+constexpr char TABLE_LETTERS[5] = {'Q', 'R', 'B', 'N', 'P'};
+/// Position of each Type in TABLE_TYPES, indexed by Type
+constexpr int TABLE_ORDER[6] = {4, 3, 2, 1, -1, 0};
+
+/// Material keys count 0, 1 or 2 of each of the 5 types of each team as a base 3 digit
+constexpr int MATERIAL_KEYS = 59049;
+constexpr int POW3[10] = {1, 3, 9, 27, 81, 243, 729, 2187, 6561, 19683};
+
+int material_digit(bool team_white, Type type) { return POW3[team_white * 5 + TABLE_ORDER[type]]; }
+
+/// @brief Board index after each of the 8 symmetries of the board: bit 0 mirrors the columns, bit 1 the rows, and bit 2 then mirrors along the a1-h8 diagonal
+struct Transforms {
+    uint8_t squares[8][64];
+};
+
+constexpr Transforms make_transforms() {
+    Transforms transforms{};
+    for (int t = 0; t < 8; ++t) {
+        for (int pos = 0; pos < 64; ++pos) {
+            int row = row_of(pos);
+            int col = col_of(pos);
+            if (t & 1) {
+                col = 7 - col;
+            }
+            if (t & 2) {
+                row = 7 - row;
+            }
+            if (t & 4) {
+                int diagonal_row = 7 - col;
+                col = 7 - row;
+                row = diagonal_row;
+            }
+            transforms.squares[t][pos] = uint8_t(row * 8 + col);
+        }
+    }
+    return transforms;
+}
+
+constexpr Transforms TRANSFORMS = make_transforms();
+
+/// @brief Tiles the white king is stored on: the a1-d1-d4 triangle without pawns, the a-d columns with them
+struct KingSlots {
+    /// Slot of each tile, -1 if the king is never stored there
+    int8_t slot[64];
+    uint8_t square[32];
+    int count;
+    /// Symmetries moving each tile onto a slot, two for the diagonal of the triangle
+    uint8_t transforms[64][2];
+    uint8_t transform_count[64];
+};
+
+constexpr KingSlots make_king_slots(bool pawns) {
+    KingSlots slots{};
+    for (int pos = 0; pos < 64; ++pos) {
+        int row = row_of(pos);
+        int col = col_of(pos);
+        bool stored = pawns ? col < 4 : row >= 4 && col < 4 && 7 - row <= col;
+        slots.slot[pos] = int8_t(stored ? slots.count : -1);
+        if (stored) {
+            slots.square[slots.count++] = uint8_t(pos);
+        }
+    }
+    for (int pos = 0; pos < 64; ++pos) {
+        for (int t = 0; t < (pawns ? 2 : 8); ++t) {  // pawns only move one way, so the rows can't be mirrored
+            if (slots.slot[TRANSFORMS.squares[t][pos]] >= 0) {
+                slots.transforms[pos][slots.transform_count[pos]++] = uint8_t(t);
+            }
+        }
+    }
+    return slots;
+}
+
+constexpr KingSlots PAWNLESS_KING_SLOTS = make_king_slots(false);
+constexpr KingSlots PAWN_KING_SLOTS = make_king_slots(true);
+
+/// @brief The pieces of one table besides the kings, white ones first, each team's strongest first
+struct Material {
+    int extras = 0;
+    Type types[2] = {PAWN, PAWN};
+    bool whites[2] = {false, false};
+};
+
+/// Every table with up to pieces pieces, the team with more or stronger pieces as white, each listed after every table its captures and promotions lead to
+std::vector<Material> table_materials(int pieces) {
+    // one team's pieces as TABLE_TYPES positions, strongest first
+    std::vector<std::vector<int>> sides = {{}};
+    for (int a = 0; a < 5; ++a) {
+        sides.push_back({a});
+        for (int b = a; b < 5; ++b) {
+            sides.push_back({a, b});
+        }
+    }
+
+    std::vector<Material> materials;
+    for (const std::vector<int> &white : sides) {
+        for (const std::vector<int> &black : sides) {
+            int extras = int(white.size() + black.size());
+            if (extras == 0 || extras + 2 > pieces) {
+                continue;
+            }
+            if (black.size() > white.size() || (black.size() == white.size() && black < white)) {
+                continue;  // the same table with the colours swapped
+            }
+            Material material;
+            for (int order : white) {
+                material.types[material.extras] = TABLE_TYPES[order];
+                material.whites[material.extras++] = true;
+            }
+            for (int order : black) {
+                material.types[material.extras] = TABLE_TYPES[order];
+                material.whites[material.extras++] = false;
+            }
+            materials.push_back(material);
+        }
+    }
+
+    // fewer pieces first for captures, then fewer pawns for promotions
+    auto pawns = [](const Material &material) { return (material.types[0] == PAWN) + (material.extras == 2 && material.types[1] == PAWN); };
+    std::stable_sort(materials.begin(), materials.end(), [&](const Material &a, const Material &b) {
+        return a.extras != b.extras ? a.extras < b.extras : pawns(a) < pawns(b);
+    });
+    return materials;
+}
+
+TbProbe decode_result(uint8_t code) {
+    TbProbe result;
+    if (code != CODE_DRAW) {
+        result.result = code < CODE_LOSS ? TB_WIN : TB_LOSS;
+        result.plies = code < CODE_LOSS ? 2 * code - 1 : 2 * (code - CODE_LOSS);
+    }
+    return result;
+}
+
+/// Runs work(begin, end) over threads equal parts of 0 to size at once, returns the sum of what they return
+template <typename F>
+size_t parallel_for(size_t size, int threads, F work) {
+    std::vector<size_t> results(threads);
+    std::vector<std::thread> workers;
+    size_t part = (size + threads - 1) / threads;
+    for (int t = 0; t < threads; ++t) {
+        size_t begin = std::min(size, t * part);
+        size_t end = std::min(size, begin + part);
+        workers.emplace_back([&results, &work, t, begin, end] { results[t] = work(begin, end); });
+    }
+    size_t sum = 0;
+    for (int t = 0; t < threads; ++t) {
+        workers[t].join();
+        sum += results[t];
+    }
+    return sum;
+}
+
+/// Where a retrograde position stands while its table is solved
+enum SolveState : uint8_t {
+    UNKNOWN,
+    ILLEGAL,
+    DRAWN,
+    WON,
+    LOST
+};
+
+/// Set in a position's count of moves when a capture or promotion draws, so it is never lost
+constexpr uint8_t DRAW_BIT = 128;
+/// win_at of a position no move is known to win
+constexpr uint8_t NO_WIN = 255;
+
+/// position after a capture or promotion
+Position after_move(const Position &position, Move move) {
+    Position next = position;
+    if (!next.is_empty(move.end())) {
+        next.remove_piece(move.end());
+    }
+    next.relocate_piece(move.start(), move.end());
+    if (move.flag() == PROMOTION) {
+        bool team_white = is_white(next.piece_on(move.end()));
+        next.remove_piece(move.end());
+        next.put_piece(move.end(), move.promotion(), team_white);
+    }
+    next.white_to_move = !next.white_to_move;
+    return next;
+}
+
+Bitboard piece_moves(Type type, int pos, Bitboard occupied) {
+    switch (type) {
+        case KNIGHT:
+            return knight_attacks(pos);
+        case BISHOP:
+            return bishop_attacks(pos, occupied);
+        case ROOK:
+            return rook_attacks(pos, occupied);
+        case QUEEN:
+            return queen_attacks(pos, occupied);
+        default:
+            return king_attacks(pos);
+    }
+}
+}  // namespace
+
+/// @brief One table: its pieces, how positions are indexed, and the bytes, mapped from a file or generated
+struct Tablebase::Table {
+    explicit Table(const Material &material);
+    ~Table();
+
+    std::string name;
+    int extras;
+    Type types[2];
+    bool whites[2];
+    /// Both non-king pieces are the same type and team, so swapping their tiles gives the same position
+    bool identical;
+    const KingSlots &king_slots;
+    /// Bytes in the table, one per index
+    size_t size;
+
+    const uint8_t *data = nullptr;
+    /// data when it was generated, or read on systems without mmap
+    std::vector<uint8_t> owned;
+    void *mapping = nullptr;
+    size_t mapping_size = 0;
+
+    /// Index of the position with these tiles, extra_pos in the order of types
+    size_t index(int wk, int bk, const int *extra_pos, bool white_to_move) const;
+    /// Tiles of the position at index i, returns white_to_move
+    bool decode(size_t i, int &wk, int &bk, int *extra_pos) const;
+    /// Key of the table's pieces, or of them with the colours swapped
+    int material_key(bool swapped) const;
+    /// The 16 bytes a file of this table starts with
+    std::string header() const;
+
+    Table(const Table &other) = delete;
+    Table &operator=(const Table &other) = delete;
+};
+
+Tablebase::Table::Table(const Material &material)
+    : extras{material.extras},
+      types{material.types[0], material.types[1]},
+      whites{material.whites[0], material.whites[1]},
+      identical{material.extras == 2 && material.types[0] == material.types[1] && material.whites[0] == material.whites[1]},
+      king_slots{(material.types[0] == PAWN || (material.extras == 2 && material.types[1] == PAWN)) ? PAWN_KING_SLOTS : PAWNLESS_KING_SLOTS} {
+    size = size_t(2) * king_slots.count * 64 * 64 * (extras == 2 ? 64 : 1);
+    for (bool team_white : {true, false}) {
+        name += 'K';
+        for (int j = 0; j < extras; ++j) {
+            if (whites[j] == team_white) {
+                name += TABLE_LETTERS[TABLE_ORDER[types[j]]];
+            }
+        }
+        if (team_white) {
+            name += 'v';
+        }
+    }
+}
+
+Tablebase::Table::~Table() {
+#ifndef _WIN32
+    if (mapping) {
+        munmap(mapping, mapping_size);
+    }
+#endif
+}
+
+size_t Tablebase::Table::index(int wk, int bk, const int *extra_pos, bool white_to_move) const {
+    size_t best = SIZE_MAX;
+    for (int c = 0; c < king_slots.transform_count[wk]; ++c) {
+        const uint8_t *squares = TRANSFORMS.squares[king_slots.transforms[wk][c]];
+        int first = squares[extra_pos[0]];
+        int second = extras == 2 ? squares[extra_pos[1]] : 0;
+        if (identical && first > second) {
+            std::swap(first, second);
+        }
+        size_t i = (size_t(white_to_move) * king_slots.count + king_slots.slot[squares[wk]]) * 64 + squares[bk];
+        i = i * 64 + first;
+        if (extras == 2) {
+            i = i * 64 + second;
+        }
+        best = std::min(best, i);
+    }
+    return best;
+}
+
+bool Tablebase::Table::decode(size_t i, int &wk, int &bk, int *extra_pos) const {
+    if (extras == 2) {
+        extra_pos[1] = int(i % 64);
+        i /= 64;
+    }
+    extra_pos[0] = int(i % 64);
+    i /= 64;
+    bk = int(i % 64);
+    i /= 64;
+    wk = king_slots.square[i % king_slots.count];
+    return i / king_slots.count;
+}
+
+int Tablebase::Table::material_key(bool swapped) const {
+    int key = 0;
+    for (int j = 0; j < extras; ++j) {
+        key += material_digit(whites[j] != swapped, types[j]);
+    }
+    return key;
+}
+
+std::string Tablebase::Table::header() const {
+    std::string bytes(MAGIC, sizeof(MAGIC));
+    bytes += char(extras);
+    for (int j = 0; j < 2; ++j) {
+        bytes += char(j < extras ? types[j] : 0);
+        bytes += char(j < extras && whites[j]);
+    }
+    bytes.resize(HEADER_SIZE, '\0');
+    return bytes;
+}
+
+Tablebase::Tablebase() : by_material(MATERIAL_KEYS, 0) {}
+
+Tablebase::~Tablebase() = default;
+
+void Tablebase::add(std::unique_ptr<Table> table) {
+    int key = table->material_key(false);
+    int swapped_key = table->material_key(true);
+    largest = std::max(largest, table->extras + 2);
+    tables.push_back(std::move(table));
+    by_material[key] = uint16_t(tables.size());
+    if (swapped_key != key) {
+        by_material[swapped_key] = uint16_t(tables.size() | 0x8000);
+    }
+}
+
+bool Tablebase::probe(const Position &position, TbProbe &result) const {
+    int pieces = position.w_num_pieces + position.b_num_pieces;
+    if (position.castling_rights || position.ep_index != -1) {
+        return false;
+    }
+    if (pieces == 2) {  // two kings can't mate
+        result = TbProbe{};
+        return true;
+    }
+    if (pieces > largest) {
+        return false;
+    }
+
+    int key = 0;
+    for (bool team_white : {false, true}) {
+        for (Type type : TABLE_TYPES) {
+            key += popcount(position.pieces(team_white, type)) * material_digit(team_white, type);
+        }
+    }
+    uint16_t entry = by_material[key];
+    if (!entry) {
+        return false;
+    }
+    const Table &table = *tables[(entry & 0x7FFF) - 1];
+
+    // with the colours swapped, black's pieces play white's and the board is mirrored top to bottom
+    bool swapped = entry & 0x8000;
+    int flip = swapped ? 56 : 0;
+    int extra_pos[2];
+    for (int j = 0; j < table.extras; ++j) {
+        Bitboard pieces_bb = position.pieces(table.whites[j] != swapped, table.types[j]);
+        extra_pos[j] = (j == 1 && table.identical ? msb(pieces_bb) : lsb(pieces_bb)) ^ flip;
+    }
+    int wk = position.king_index(!swapped) ^ flip;
+    int bk = position.king_index(swapped) ^ flip;
+    uint8_t code = table.data[table.index(wk, bk, extra_pos, position.white_to_move != swapped)];
+    if (code == CODE_ILLEGAL) {
+        return false;
+    }
+    result = decode_result(code);
+    return true;
+}
+
+int Tablebase::load(const std::string &directory) {
+    int found = 0;
+    for (const Material &material : table_materials(TB_MAX_PIECES)) {
+        std::unique_ptr<Table> table{new Table(material)};
+        if (by_material[table->material_key(false)]) {
+            continue;
+        }
+        std::string path = directory + "/" + table->name + ".ctb";
+        std::string header = table->header();
+#ifndef _WIN32
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            continue;
+        }
+        struct stat file_stat;
+        bool sized = fstat(fd, &file_stat) == 0 && size_t(file_stat.st_size) == HEADER_SIZE + table->size;
+        void *mapping = sized ? mmap(nullptr, HEADER_SIZE + table->size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        close(fd);  // the mapping stays valid without the descriptor
+        if (mapping == MAP_FAILED) {
+            continue;
+        }
+        table->mapping = mapping;
+        table->mapping_size = HEADER_SIZE + table->size;
+        const uint8_t *bytes = static_cast<const uint8_t *>(mapping);
+#else
+        std::ifstream file{path, std::ios::binary};
+        table->owned.resize(HEADER_SIZE + table->size);
+        if (!file.read(reinterpret_cast<char *>(table->owned.data()), table->owned.size()) || file.peek() != EOF) {
+            continue;
+        }
+        const uint8_t *bytes = table->owned.data();
+#endif
+        if (std::memcmp(bytes, header.data(), HEADER_SIZE) != 0) {
+            continue;
+        }
+        table->data = bytes + HEADER_SIZE;
+        add(std::move(table));
+        ++found;
+    }
+    return found;
+}
+
+void Tablebase::generate(const std::string &directory, int pieces, int threads, std::ostream *log) {
+    threads = std::max(threads, 1);
+    for (const Material &material : table_materials(std::min(pieces, TB_MAX_PIECES))) {
+        std::unique_ptr<Table> table{new Table(material)};
+        if (by_material[table->material_key(false)]) {
+            continue;  // loaded already
+        }
+        auto start = std::chrono::steady_clock::now();
+        solve(*table, threads);
+
+        std::string path = directory + "/" + table->name + ".ctb";
+        std::ofstream file{path, std::ios::binary};
+        file << table->header();
+        file.write(reinterpret_cast<const char *>(table->data), table->size);
+        if (!file) {
+            throw std::runtime_error("can't write " + path);
+        }
+
+        if (log) {
+            int longest = 0;
+            size_t wins = 0;
+            size_t draws = 0;
+            size_t losses = 0;
+            for (size_t i = 0; i < table->size; ++i) {
+                uint8_t code = table->data[i];
+                if (code == CODE_ILLEGAL) {
+                    continue;
+                }
+                TbProbe result = decode_result(code);
+                longest = std::max(longest, result.plies);
+                (result.result == TB_WIN ? wins : result.result == TB_DRAW ? draws : losses) += 1;
+            }
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+            *log << table->name << ": " << wins << " won, " << draws << " drawn, " << losses << " lost, longest mate "
+                 << longest << " plies, " << elapsed.count() << " ms" << std::endl;
+        }
+        add(std::move(table));
+    }
+}
+
+void Tablebase::solve(Table &table, int threads) const {
+    size_t size = table.size;
+    std::vector<uint8_t> state(size, UNKNOWN);
+    /// Different positions the quiet moves lead to that aren't known to be won for the other team yet, with DRAW_BIT
+    std::vector<uint8_t> moves_left(size, 0);
+    /// Plies to mate of the quickest known win, NO_WIN if none, and of the slowest loss, once resolved the distance of the result
+    std::vector<uint8_t> win_at(size, NO_WIN);
+    std::vector<uint8_t> loss_at(size, 0);
+
+    // find every position's moves, resolving checkmates, stalemates, captures and promotions
+    parallel_for(size, threads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            int wk, bk;
+            int extra_pos[2] = {0, 0};
+            bool white_to_move = table.decode(i, wk, bk, extra_pos);
+            Bitboard occupied = square_bb(wk) | square_bb(bk);
+            bool legal = wk != bk && table.index(wk, bk, extra_pos, white_to_move) == i;  // the other copies of a symmetric position are never used
+            for (int j = 0; j < table.extras; ++j) {
+                legal &= !(occupied & square_bb(extra_pos[j]));
+                legal &= table.types[j] != PAWN || (row_of(extra_pos[j]) != 0 && row_of(extra_pos[j]) != 7);
+                occupied |= square_bb(extra_pos[j]);
+            }
+            if (!legal) {
+                state[i] = ILLEGAL;
+                continue;
+            }
+            Position position;
+            position.clear_pieces();
+            position.put_piece(wk, KING, true);
+            position.put_piece(bk, KING, false);
+            for (int j = 0; j < table.extras; ++j) {
+                position.put_piece(extra_pos[j], table.types[j], table.whites[j]);
+            }
+            position.white_to_move = white_to_move;
+            if (attackers_to(position, position.king_index(!white_to_move), occupied) & position.pieces(white_to_move)) {
+                state[i] = ILLEGAL;  // the team that just moved left its king in check
+                continue;
+            }
+
+            MoveList moves;
+            generate_legal_moves(position, moves);
+            if (moves.empty()) {
+                bool in_check = attackers_to(position, position.king_index(white_to_move), occupied) & position.pieces(!white_to_move);
+                state[i] = in_check ? LOST : DRAWN;
+                continue;
+            }
+            size_t children[MAX_MOVES];
+            int child_count = 0;
+            for (Move move : moves) {
+                if (!position.is_empty(move.end()) || move.flag() == PROMOTION) {
+                    TbProbe child;
+                    if (!probe(after_move(position, move), child)) {
+                        child = TbProbe{};  // generate() adds the smaller tables first, so this never happens
+                    }
+                    if (child.result == TB_LOSS) {
+                        win_at[i] = uint8_t(std::min<int>(win_at[i], child.plies + 1));
+                    } else if (child.result == TB_WIN) {
+                        loss_at[i] = uint8_t(std::max<int>(loss_at[i], child.plies + 1));
+                    } else {
+                        moves_left[i] = DRAW_BIT;
+                    }
+                    continue;
+                }
+                int next_wk = wk == move.start() ? move.end() : wk;
+                int next_bk = bk == move.start() ? move.end() : bk;
+                int next_pos[2] = {extra_pos[0], extra_pos[1]};
+                for (int j = 0; j < table.extras; ++j) {
+                    if (next_pos[j] == move.start()) {
+                        next_pos[j] = move.end();
+                    }
+                }
+                size_t child = table.index(next_wk, next_bk, next_pos, !white_to_move);
+                if (std::find(children, children + child_count, child) == children + child_count) {
+                    children[child_count++] = child;
+                }
+            }
+            moves_left[i] |= uint8_t(child_count);
+        }
+        return size_t(0);
+    });
+
+    // a capture or promotion can be the quickest win, or the slowest loss, further away than any ply found by retrograde steps so far
+    int pending = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (state[i] == UNKNOWN) {
+            pending = std::max<int>(pending, std::max<int>(win_at[i] == NO_WIN ? 0 : win_at[i], loss_at[i]));
+        }
+    }
+
+    // positions resolved at ply n reach back to the positions one move before them
+    auto step_back = [&](size_t i, int n) {
+        int wk, bk;
+        int extra_pos[2] = {0, 0};
+        bool mover = !table.decode(i, wk, bk, extra_pos);
+        Bitboard occupied = square_bb(wk) | square_bb(bk);
+        for (int j = 0; j < table.extras; ++j) {
+            occupied |= square_bb(extra_pos[j]);
+        }
+
+        size_t parents[MAX_MOVES];
+        int parent_count = 0;
+        auto add_parent = [&](int parent_wk, int parent_bk, const int *parent_pos) {
+            size_t parent = table.index(parent_wk, parent_bk, parent_pos, mover);
+            if (state[parent] == UNKNOWN && std::find(parents, parents + parent_count, parent) == parents + parent_count) {
+                parents[parent_count++] = parent;
+            }
+        };
+
+        Bitboard from = king_attacks(mover ? wk : bk) & ~occupied;
+        while (from) {
+            int pos = pop_lsb(from);
+            add_parent(mover ? pos : wk, mover ? bk : pos, extra_pos);
+        }
+        for (int j = 0; j < table.extras; ++j) {
+            if (table.whites[j] != mover) {
+                continue;
+            }
+            if (table.types[j] == PAWN) {  // one tile back, or two from the tile a two tile move lands on
+                int back = mover ? 8 : -8;
+                int pos = extra_pos[j] + back;
+                from = EMPTY_BB;
+                if (!(occupied & square_bb(pos)) && row_of(pos) != 0 && row_of(pos) != 7) {
+                    from |= square_bb(pos);
+                    if (row_of(extra_pos[j]) == (mover ? 4 : 3) && !(occupied & square_bb(pos + back))) {
+                        from |= square_bb(pos + back);
+                    }
+                }
+            } else {
+                from = piece_moves(table.types[j], extra_pos[j], occupied) & ~occupied;
+            }
+            while (from) {
+                int parent_pos[2] = {extra_pos[0], extra_pos[1]};
+                parent_pos[j] = pop_lsb(from);
+                add_parent(wk, bk, parent_pos);
+            }
+        }
+
+        uint8_t next = uint8_t(n + 1);
+        for (int p = 0; p < parent_count; ++p) {
+            size_t parent = parents[p];
+            if (n % 2 == 0) {  // a move into a lost position wins
+                if (__atomic_load_n(&win_at[parent], __ATOMIC_RELAXED) > next) {
+                    __atomic_store_n(&win_at[parent], next, __ATOMIC_RELAXED);
+                }
+            } else {  // a move into a won position is one less way out
+                if (__atomic_load_n(&loss_at[parent], __ATOMIC_RELAXED) < next) {
+                    __atomic_store_n(&loss_at[parent], next, __ATOMIC_RELAXED);
+                }
+                __atomic_sub_fetch(&moves_left[parent], 1, __ATOMIC_RELAXED);
+            }
+        }
+    };
+
+    for (int n = 0; n <= MAX_PLIES; ++n) {
+        // wins are resolved at odd plies and losses at even ones
+        size_t found = parallel_for(size, threads, [&](size_t begin, size_t end) {
+            size_t resolved = 0;
+            for (size_t i = begin; i < end; ++i) {
+                if (n == 0) {
+                    resolved += state[i] == LOST;  // checkmates
+                } else if (state[i] != UNKNOWN) {
+                    continue;
+                } else if (n % 2 == 1 && win_at[i] == n) {
+                    state[i] = WON;
+                    ++resolved;
+                } else if (n % 2 == 0 && moves_left[i] == 0 && win_at[i] == NO_WIN && loss_at[i] == n) {
+                    state[i] = LOST;
+                    ++resolved;
+                }
+            }
+            return resolved;
+        });
+        if (!found) {
+            if (n >= pending) {
+                break;
+            }
+            continue;
+        }
+        if (n == MAX_PLIES) {
+            break;
+        }
+        parallel_for(size, threads, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                if (n % 2 == 1 ? state[i] == WON && win_at[i] == n : state[i] == LOST && loss_at[i] == n) {
+                    step_back(i, n);
+                }
+            }
+            return size_t(0);
+        });
+    }
+
+    table.owned.resize(size);
+    for (size_t i = 0; i < size; ++i) {
+        switch (state[i]) {
+            case ILLEGAL:
+                table.owned[i] = CODE_ILLEGAL;
+                break;
+            case WON:
+                table.owned[i] = uint8_t((win_at[i] + 1) / 2);
+                break;
+            case LOST:
+                table.owned[i] = uint8_t(CODE_LOSS + loss_at[i] / 2);
+                break;
+            default:  // nothing forces a mate
+                table.owned[i] = CODE_DRAW;
+        }
+    }
+    table.data = table.owned.data();
+}
@@ -0,0 +1,68 @@
+/**
+ * @file tablebase.h
+ * @brief Perfect play for every game state with few pieces left, from endgame tables built ahead of time.
+ *
+ * An endgame table holds, for every arrangement of one set of pieces (KRvK, KQvKR, KPvKP and so on) with either team to move, whether the team to move wins, draws or loses and in how many plies the game ends in checkmate with best play from both sides (see https://www.chessprogramming.org/Endgame_Tablebases). generate() builds every table with up to TB_MAX_PIECES pieces by retrograde analysis: checkmates are found first, then every position one move before a checkmate, then one move before those, and so on, by walking the moves backwards, until nothing changes and every position left over is a draw. Captures and promotions lead into smaller tables, which are always built first. The positions of one table are split between threads.
+ *
+ * Each table is a file of one byte per position after a 16 byte header, the team with more material always playing white. Positions are indexed by the white king's tile (only one of the board's symmetric copies is stored: a tenth of the board without pawns, half of it with pawns), the black king's tile and each other piece's tile, so finding a position's byte is arithmetic with no search. load() maps the files into memory with mmap, and probe() reads them without locks, so every search thread can probe at once for the cost of a couple of memory loads.
+ *
+ * Positions where castling or an en passant capture is possible are not in the tables. Generation treats a two tile pawn move as if it gave no en passant capture, which only matters in KPvKP.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "position.h"
+
+/// Most pieces, kings included, of any table generate() builds
+constexpr int TB_MAX_PIECES = 4;
+
+enum TbResult : int8_t {
+    TB_LOSS = -1,
+    TB_DRAW = 0,
+    TB_WIN = 1
+};
+
+/// @brief What a table says about a position, for the team to move
+struct TbProbe {
+    TbResult result = TB_DRAW;
+    /// Plies until checkmate with best play from both teams, 0 for a draw
+    int plies = 0;
+};
+
+/// @brief Endgame tables, loaded from files or generated, shared read only by every search thread
+class Tablebase {
+   public:
+    Tablebase();
+    ~Tablebase();
+
+    /// Maps every table file found in directory into memory, returns how many were found
+    int load(const std::string &directory);
+    /// Builds every table with up to pieces pieces (at most TB_MAX_PIECES) that isn't loaded, on threads threads, writing each to directory as soon as it is done, throws std::runtime_error if a file can't be written
+    void generate(const std::string &directory, int pieces, int threads, std::ostream *log = nullptr);
+
+    /// Sets result and returns true if a table holds position
+    bool probe(const Position &position, TbProbe &result) const;
+    /// Most pieces of any table held, 0 with none
+    int max_pieces() const { return largest; }
+    int table_count() const { return int(tables.size()); }
+
+   private:
+    struct Table;
+    std::vector<std::unique_ptr<Table>> tables;
+    /// Indexed by material key: index into tables + 1 (0 for no table), with the top bit set when the colours are swapped in the table
+    std::vector<uint16_t> by_material;
+    int largest = 0;
+
+    /// Makes table available to probe()
+    void add(std::unique_ptr<Table> table);
+    /// Fills in every position of table, every table its captures and promotions lead to must already be added
+    void solve(Table &table, int threads) const;
+
+    Tablebase(const Tablebase &other) = delete;
+    Tablebase &operator=(const Tablebase &other) = delete;
+};
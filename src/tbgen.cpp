@@ -0,0 +1,34 @@
+/**
+ * @file tbgen.cpp
+ * @brief Generates the endgame tables the Agent probes (see tablebase.h).
+ *
+ * Builds every table with up to the given number of pieces that isn't in the directory yet, smallest first, and writes each one there as soon as it is finished, so an interrupted run picks up where it stopped. Each table's positions are split between the given number of threads.
+ *
+ * Usage: tbgen [directory] [pieces] [threads]
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "tablebase.h"
+
+int main(int argc, char **argv) {
+    std::string directory = argc > 1 ? argv[1] : "tablebases";
+    int pieces = argc > 2 ? std::atoi(argv[2]) : TB_MAX_PIECES;
+    int threads = argc > 3 ? std::atoi(argv[3]) : int(std::max(1u, std::thread::hardware_concurrency()));
+
+    try {
+        std::filesystem::create_directories(directory);
+        Tablebase tablebase;
+        int found = tablebase.load(directory);
+        std::cout << found << " tables already in " << directory << "\n";
+        tablebase.generate(directory, pieces, threads, &std::cout);
+    } catch (const std::exception &error) {
+        std::cerr << "tbgen: " << error.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,103 @@
+/**
+ * @file transposition_table.cpp
+ * @brief Remembers the results of positions the Agent has already searched.
+ *
+ * Entries are written as two relaxed atomic stores and read as two relaxed atomic loads, so concurrent access is well defined without ever taking a lock. An entry is only trusted when its key word XORed with its data word gives back the probed key, which rejects both other positions landing in the same bucket and entries torn by a concurrent write.
+ */
+#include "transposition_table.h"
+
+TranspositionTable::TranspositionTable(size_t size_mb) {
+    resize(size_mb);
+}
+
+void TranspositionTable::resize(size_t size_mb) {
+    size_t count = 1;
+    size_t bytes = (size_mb < 1 ? 1 : size_mb) << 20;
+    while (count * 2 * sizeof(Bucket) <= bytes) {
+        count *= 2;
+    }
+    buckets.reset(new Bucket[count]);
+    bucket_mask = count - 1;
+    clear();
+}
+
+void TranspositionTable::clear() {
+    for (size_t i = 0; i <= bucket_mask; ++i) {
+        for (Slot &slot : buckets[i].slots) {
+            slot.key_xor_data.store(0, std::memory_order_relaxed);
+            slot.data.store(0, std::memory_order_relaxed);
+        }
+    }
+    generation = 0;
+}
+
+void TranspositionTable::new_search() {
+    generation = (generation + 1) & 63;
+}
+
+uint64_t TranspositionTable::pack(Move move, int score, int depth, Bound bound, uint8_t generation) {
+    return uint64_t(move.raw()) |
+           uint64_t(uint16_t(int16_t(score))) << 16 |
+           uint64_t(uint8_t(depth)) << 32 |
+           uint64_t(bound) << 40 |
+           uint64_t(generation) << 58;
+}
+
+TTEntry TranspositionTable::unpack(uint64_t data) {
+    return TTEntry{Move::from_raw(uint16_t(data)), int16_t(data >> 16), uint8_t(data >> 32), Bound((data >> 40) & 3)};
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntry &entry) const {
+    const Bucket &bucket = buckets[key & bucket_mask];
+    for (const Slot &slot : bucket.slots) {
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        if ((slot.key_xor_data.load(std::memory_order_relaxed) ^ data) == key && Bound((data >> 40) & 3) != BOUND_NONE) {
+            entry = unpack(data);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TranspositionTable::store(uint64_t key, int depth, Bound bound, int score, Move move) {
+    Bucket &bucket = buckets[key & bucket_mask];
+    Slot *replace = nullptr;
+    int worst = 0;
+    for (Slot &slot : bucket.slots) {
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        if ((slot.key_xor_data.load(std::memory_order_relaxed) ^ data) == key) {
+            TTEntry old = unpack(data);
+            if (!move) {  // keep the best move found by an earlier search of this position
+                move = old.move;
+            }
+            // a shallower non exact result from the same search is worth less than what is already here
+            if (bound != BOUND_EXACT && depth < old.depth - 2 && age_of(data) == 0) {
+                return;
+            }
+            replace = &slot;
+            break;
+        }
+        // empty slots score lowest, then shallow entries from old searches
+        int value = Bound((data >> 40) & 3) == BOUND_NONE ? -1000 : int(uint8_t(data >> 32)) - 8 * age_of(data);
+        if (!replace || value < worst) {
+            replace = &slot;
+            worst = value;
+        }
+    }
+
+    uint64_t data = pack(move, score, depth, bound, generation);
+    replace->key_xor_data.store(key ^ data, std::memory_order_relaxed);
+    replace->data.store(data, std::memory_order_relaxed);
+}
+
+int TranspositionTable::hashfull() const {
+    int used = 0;
+    size_t sampled = bucket_mask + 1 < 250 ? bucket_mask + 1 : 250;
+    for (size_t i = 0; i < sampled; ++i) {
+        for (const Slot &slot : buckets[i].slots) {
+            uint64_t data = slot.data.load(std::memory_order_relaxed);
+            used += Bound((data >> 40) & 3) != BOUND_NONE && age_of(data) == 0;
+        }
+    }
+    return used * 1000 / int(sampled * BUCKET_SIZE);
+}
@@ -0,0 +1,100 @@
+/**
+ * @file transposition_table.h
+ * @brief Remembers the results of positions the Agent has already searched.
+ *
+ * The same position is often reached through many different move orders. The TranspositionTable stores what a search learned about a position (how deep it looked, the score it found, whether that score is exact or only a bound, and the best move) under the position's Zobrist key, so the next time the position comes up the search can reuse the result or at least try the best move first (see https://www.chessprogramming.org/Transposition_Table).
+ *
+ * The table is a power of two number of 64 byte buckets, each holding four entries, so a probe touches a single cache line. Entries are two 64 bit words, the packed data and the key XORed with that data. Threads read and write entries without locks; if two writes to the same entry interleave, the key no longer matches its data and the torn entry is simply treated as a miss. When a bucket is full the entry that is shallowest and oldest (from earlier searches) is replaced.
+ */
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "move.h"
+
+/// Larger than any score evaluate() can return, a mate found n plies from the root scores MATE_SCORE - n
+constexpr int MATE_SCORE = 30000;
+/// Deepest ply a search can reach
+constexpr int MAX_PLY = 128;
+/// Scores at or beyond this (either sign) are mates
+constexpr int MATE_BOUND = MATE_SCORE - MAX_PLY;
+
+/// Score of a mate plies moves ahead of a position ply moves from the root, kept at MATE_BOUND when the mate is further than MAX_PLY from the root (as endgame tables can give) so it is still a mate
+inline int mate_in(int ply, int plies) { return std::max(MATE_SCORE - ply - plies, MATE_BOUND); }
+
+/// What a stored score says about the true score of a position
+enum Bound : uint8_t {
+    BOUND_NONE,
+    /// True score is at most the stored score (no move raised alpha)
+    BOUND_UPPER,
+    /// True score is at least the stored score (a move caused a cutoff)
+    BOUND_LOWER,
+    BOUND_EXACT
+};
+
+/// @brief One decoded table entry
+struct TTEntry {
+    Move move;
+    int score;
+    int depth;
+    Bound bound;
+};
+
+/// Mate scores are stored as distance from the position instead of distance from the root, so they stay right when the position is reached at another ply
+inline int score_to_tt(int score, int ply) {
+    return score >= MATE_BOUND ? score + ply : score <= -MATE_BOUND ? score - ply : score;
+}
+/// Undoes score_to_tt() for a position found ply moves from the root, a mate found deeper than it was stored stays a mate
+inline int score_from_tt(int score, int ply) {
+    return score >= MATE_BOUND ? std::max(score - ply, MATE_BOUND) : score <= -MATE_BOUND ? std::min(score + ply, -MATE_BOUND) : score;
+}
+
+/// @brief Fixed size, lock free hash table of search results shared by every thread
+class TranspositionTable {
+   public:
+    explicit TranspositionTable(size_t size_mb = 16);
+
+    /// Reallocates the table with the largest power of two number of buckets fitting in size_mb (at least 1) and clears it
+    void resize(size_t size_mb);
+    /// Forgets every entry
+    void clear();
+    /// Call before each search, entries from earlier searches become the first to be replaced
+    void new_search();
+
+    /// Fills entry and returns true if the table has a result for key
+    bool probe(uint64_t key, TTEntry &entry) const;
+    /// Stores a result for key, the score must already be adjusted with score_to_tt()
+    void store(uint64_t key, int depth, Bound bound, int score, Move move);
+
+    /// How full the table is with entries from the current search, in permille
+    int hashfull() const;
+    size_t size_mb() const { return (bucket_mask + 1) * sizeof(Bucket) >> 20; }
+
+   private:
+    /// Packed data: move (16 bits), score (16), depth (8), bound (2), generation (6)
+    struct Slot {
+        std::atomic<uint64_t> key_xor_data;
+        std::atomic<uint64_t> data;
+    };
+    static constexpr int BUCKET_SIZE = 4;
+    struct alignas(64) Bucket {
+        Slot slots[BUCKET_SIZE];
+    };
+    static_assert(sizeof(Bucket) == 64, "a bucket should fill exactly one cache line");
+
+    static uint64_t pack(Move move, int score, int depth, Bound bound, uint8_t generation);
+    static TTEntry unpack(uint64_t data);
+    static uint8_t generation_of(uint64_t data) { return data >> 58; }
+    /// Searches since the entry was written, wrapping at 64
+    int age_of(uint64_t data) const { return (generation - generation_of(data)) & 63; }
+
+    std::unique_ptr<Bucket[]> buckets;
+    size_t bucket_mask = 0;
+    uint8_t generation = 0;
+
+    TranspositionTable(const TranspositionTable &other) = delete;
+    TranspositionTable &operator=(const TranspositionTable &other) = delete;
+};
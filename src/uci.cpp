@@ -0,0 +1,245 @@
+/**
+ * @file uci.cpp
+ * @brief Plays through the Universal Chess Interface, so the agent can run without a screen.
+ *
+ * UCI names tiles a1 to h8 and writes castling as the king's two tile move (e1g1), which is how Move stores it too, so converting a move is only a matter of converting its tiles.
+ */
+#include "uci.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+namespace {
+constexpr int DEFAULT_HASH_MB = 16;
+constexpr int MAX_HASH_MB = 65536;
+constexpr int MAX_THREADS = 256;
+
+/// Tile name of board index pos, e.g. 52 is e2
+std::string tile_name(int pos) {
+    return {char('a' + pos % 8), char('8' - pos / 8)};
+}
+
+/// Board index of the tile named by text[at] and text[at + 1], -1 if they don't name one
+int tile_index(const std::string &text, size_t at) {
+    if (text.size() < at + 2 || text[at] < 'a' || text[at] > 'h' || text[at + 1] < '1' || text[at + 1] > '8') {
+        return -1;
+    }
+    return ('8' - text[at + 1]) * 8 + (text[at] - 'a');
+}
+
+/// Score as UCI reports it: centipawns, or moves until mate (negative when being mated)
+std::string score_text(int score) {
+    if (std::abs(score) >= MATE_BOUND) {
+        int moves = (MATE_SCORE - std::abs(score) + 1) / 2;
+        return "mate " + std::to_string(score > 0 ? moves : -moves);
+    }
+    return "cp " + std::to_string(score);
+}
+
+}  // namespace
+
+std::string move_to_uci(Move move) {
+    std::string text = tile_name(move.start()) + tile_name(move.end());
+    if (move.flag() == PROMOTION) {
+        text += "pnbrkq"[move.promotion()];
+    }
+    return text;
+}
+
+Move move_from_uci(const Position &position, const std::string &text) {
+    int start = tile_index(text, 0);
+    int end = tile_index(text, 2);
+    if (start < 0 || end < 0 || text.size() > 5) {
+        return Move();
+    }
+    MoveList legal;
+    generate_legal_moves(position, legal);
+    for (Move move : legal) {
+        if (move.start() != start || move.end() != end) {
+            continue;
+        }
+        if (move.flag() == PROMOTION ? text.size() == 5 && text[4] == "pnbrkq"[move.promotion()] : text.size() == 4) {
+            return move;
+        }
+    }
+    return Move();
+}
+
+UciEngine::UciEngine(std::ostream &out) : out{out}, board{}, agent{board} {
+    std::shared_ptr<Tablebase> tablebase{new Tablebase()};
+    if (tablebase->load("tablebases")) {  // built by tbgen, like the GUI uses them
+        agent.tablebase = tablebase;
+    }
+}
+
+UciEngine::~UciEngine() { stop(); }
+
+void UciEngine::loop(std::istream &in) {
+    std::string line;
+    while (std::getline(in, line) && command(line)) {
+    }
+    stop();
+}
+
+bool UciEngine::command(const std::string &line) {
+    std::istringstream args{line};
+    std::string name;
+    args >> name;
+    if (name == "uci") {
+        send("id name Chess");
+        send("id author Luke Guldberg");
+        send("option name Hash type spin default " + std::to_string(DEFAULT_HASH_MB) + " min 1 max " + std::to_string(MAX_HASH_MB));
+        send("option name Threads type spin default 1 min 1 max " + std::to_string(MAX_THREADS));
+        send("uciok");
+    } else if (name == "isready") {
+        send("readyok");
+    } else if (name == "ucinewgame") {
+        stop();
+        agent.tt.clear();
+        agent.eval_cache.clear();
+        agent.pawn_table.clear();
+        board = Chessboard();
+    } else if (name == "setoption") {
+        stop();  // the tables and threads can't change under a search
+        set_option(args);
+    } else if (name == "position") {
+        set_position(args);
+    } else if (name == "go") {
+        go(args);
+    } else if (name == "stop") {
+        stop();
+    } else if (name == "quit") {
+        stop();
+        return false;
+    } else if (!name.empty()) {
+        send("info string unknown command " + name);
+    }
+    return true;
+}
+
+void UciEngine::set_option(std::istringstream &args) {
+    std::string token, option, value;
+    args >> token;  // "name"
+    while (args >> token && token != "value") {
+        option += (option.empty() ? "" : " ") + token;
+    }
+    args >> value;
+    std::transform(option.begin(), option.end(), option.begin(), [](unsigned char c) { return std::tolower(c); });
+    int number = std::atoi(value.c_str());
+    if (option == "hash") {
+        agent.tt.resize(std::clamp(number, 1, MAX_HASH_MB));
+    } else if (option == "threads") {
+        agent.set_threads(std::clamp(number, 1, MAX_THREADS));
+    } else {
+        send("info string unknown option " + option);
+    }
+}
+
+void UciEngine::set_position(std::istringstream &args) {
+    std::string token;
+    args >> token;
+    if (token == "startpos") {
+        board = Chessboard();
+        args >> token;  // "moves", if there are any
+    } else if (token == "fen") {
+        std::string fen;
+        while (args >> token && token != "moves") {
+            fen += token + " ";
+        }
+        try {
+            board.set_fen(fen);
+        } catch (const FenError &error) {
+            send(std::string("info string invalid fen: ") + error.what());
+            return;
+        }
+    } else {
+        return;
+    }
+    while (args >> token) {
+        Move move = move_from_uci(board, token);
+        if (!move) {
+            send("info string illegal move " + token);
+            return;
+        }
+        board.make_move(move);
+    }
+}
+
+void UciEngine::go(std::istringstream &args) {
+    stop();
+    SearchLimits limits;
+    bool infinite = false;
+    std::string token;
+    int64_t value;
+    while (args >> token) {
+        if (token == "infinite") {
+            infinite = true;
+        } else if (!(args >> value)) {
+            break;
+        } else if (token == "depth") {
+            limits.depth = int(std::clamp<int64_t>(value, 1, MAX_PLY - 1));
+        } else if (token == "movetime") {
+            limits.movetime_ms = std::max<int64_t>(value, 1);
+        } else if (token == "nodes") {
+            limits.nodes = uint64_t(std::max<int64_t>(value, 1));
+        } else if (token == (board.white_to_move ? "wtime" : "btime")) {
+            limits.time_left_ms = std::max<int64_t>(value, 1);
+        } else if (token == (board.white_to_move ? "winc" : "binc")) {
+            limits.increment_ms = value;
+        }
+    }
+    agent.set_board(board);
+    stop_received = false;
+    searching = true;
+    search_thread = std::thread(&UciEngine::search, this, limits, infinite);
+}
+
+void UciEngine::search(SearchLimits limits, bool infinite) {
+    SearchResult result = agent.search(limits);
+    if (infinite) {  // the protocol wants bestmove only after stop
+        std::unique_lock<std::mutex> lock{stop_mutex};
+        stop_signal.wait(lock, [this] { return stop_received; });
+    }
+    std::ostringstream info;
+    info << "info depth " << result.depth << " score " << score_text(result.score) << " nodes " << result.nodes
+         << " nps " << result.nodes * 1000 / uint64_t(std::max<int64_t>(result.time_ms, 1)) << " time " << result.time_ms;
+    if (result.best_move) {
+        info << " pv " << move_to_uci(result.best_move);
+    }
+    send(info.str());
+    send("bestmove " + (result.best_move ? move_to_uci(result.best_move) : std::string("0000")));
+    searching = false;
+}
+
+void UciEngine::stop() {
+    if (!search_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock{stop_mutex};
+        stop_received = true;
+    }
+    stop_signal.notify_all();
+    // Agent::search() clears stop requests made before it started, so keep asking until the thread is done
+    while (searching) {
+        agent.stop();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    search_thread.join();
+}
+
+void UciEngine::wait() {
+    if (search_thread.joinable()) {
+        search_thread.join();
+    }
+}
+
+void UciEngine::send(const std::string &line) {
+    std::lock_guard<std::mutex> lock{out_mutex};
+    out << line << std::endl;
+}
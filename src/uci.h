@@ -0,0 +1,68 @@
+/**
+ * @file uci.h
+ * @brief Plays through the Universal Chess Interface, so the agent can run without a screen.
+ *
+ * UCI (see https://www.chessprogramming.org/UCI) is the text protocol chess GUIs and match servers use to drive an engine over stdin and stdout. UciEngine reads one command per line: `uci`, `isready`, `ucinewgame`, `setoption name Hash|Threads value N`, `position startpos|fen <fen> [moves ...]`, `go [depth N] [movetime N] [wtime N] [btime N] [winc N] [binc N] [nodes N] [infinite]`, `stop` and `quit`.
+ *
+ * `go` starts the Agent's search on a thread of its own and returns at once, so `isready` and `stop` are answered while it runs. When the search finishes, or is stopped, the search thread writes an `info` line with the depth, score, nodes and speed of the deepest finished iteration, then `bestmove`. A `go infinite` search holds its `bestmove` back until `stop` arrives, as the protocol asks. Output from both threads goes through one lock so lines never interleave.
+ */
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <iosfwd>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "agent.h"
+#include "chessboard.h"
+
+/// Move in UCI's long algebraic notation: start tile, end tile and the promotion's letter, e.g. e2e4 or e7e8q
+std::string move_to_uci(Move move);
+/// The legal move of position written in long algebraic notation, the null move if there is none
+Move move_from_uci(const Position &position, const std::string &text);
+
+/// @brief Answers UCI commands, searching on a thread of its own
+class UciEngine {
+   public:
+    /// Writes every reply to out
+    explicit UciEngine(std::ostream &out);
+    /// Stops any search still running
+    ~UciEngine();
+
+    /// Handles commands from in, one per line, until quit or the end of the input
+    void loop(std::istream &in);
+    /// Handles one command line, returns false for quit
+    bool command(const std::string &line);
+    /// Waits for a running search to write its bestmove, searches without a limit never finish on their own
+    void wait();
+
+   private:
+    std::ostream &out;
+    std::mutex out_mutex;
+    /// Game state set by the last position command
+    Chessboard board;
+    Agent agent;
+
+    std::thread search_thread;
+    /// Set by go and cleared by the search thread once bestmove is written
+    std::atomic<bool> searching{false};
+    /// Tells a go infinite search that stop has arrived
+    std::mutex stop_mutex;
+    std::condition_variable stop_signal;
+    bool stop_received = false;
+
+    void set_option(std::istringstream &args);
+    void set_position(std::istringstream &args);
+    void go(std::istringstream &args);
+    /// Runs on search_thread: searches, then writes info and bestmove
+    void search(SearchLimits limits, bool infinite);
+    /// Stops a running search and waits for its bestmove
+    void stop();
+    /// Writes one line of output
+    void send(const std::string &line);
+
+    UciEngine(const UciEngine &other) = delete;
+    UciEngine &operator=(const UciEngine &other) = delete;
+};
@@ -0,0 +1,31 @@
+/**
+ * @file uci_main.cpp
+ * @brief Runs the engine over UCI on stdin and stdout (see uci.h), or the bench (see bench.h).
+ *
+ * Usage: uci
+ *        uci bench [depth] [signature]
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "bench.h"
+#include "uci.h"
+
+int main(int argc, char **argv) {
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        int depth = argc > 2 ? std::clamp(std::atoi(argv[2]), 1, MAX_PLY - 1) : BENCH_DEPTH;
+        BenchResult result = run_bench(depth, &std::cerr);
+        std::cout << "nodes " << result.nodes << "\n"
+                  << "time " << result.time_ms << " ms\n"
+                  << "nps " << result.nodes * 1000 / uint64_t(std::max<int64_t>(result.time_ms, 1)) << "\n";
+        if (argc > 3 && std::strtoull(argv[3], nullptr, 10) != result.nodes) {
+            std::cerr << "bench: signature " << result.nodes << " differs from the expected " << argv[3] << "\n";
+            return 1;
+        }
+        return 0;
+    }
+    UciEngine engine{std::cout};
+    engine.loop(std::cin);
+}
@@ -0,0 +1,63 @@
+/**
+ * @file zobrist.h
+ * @brief Random keys used to give every game state a 64 bit Zobrist key.
+ *
+ * A Zobrist key is the XOR of one random number per feature of a game state: each piece on its tile, the side to move, the castling rights still available and the column of the en passant tile. Because XOR undoes itself, a move only has to XOR out the features it removes and XOR in the ones it adds, so the key is kept up to date in constant time as moves are made and taken back (see https://www.chessprogramming.org/Zobrist_Hashing). Two equal game states always share a key, which is what lets the engine recognise a position it has already seen.
+ *
+ * The keys are generated at compile time from a fixed seed, so a key is the same on every run and every machine.
+ */
+#pragma once
+#include <array>
+#include <cstdint>
+
+/// @brief Every random key, grouped by the feature it stands for
+struct ZobristKeys {
+    /// Indexed by [piece code][pos], see make_piece()
+    uint64_t pieces[12][64];
+    /// Indexed by the CastlingRight bits, so a change of rights is a single XOR
+    uint64_t castling[16];
+    /// Indexed by the column of Position::ep_index
+    uint64_t ep_col[8];
+    /// XORed in while it is black's turn
+    uint64_t black_to_move;
+};
+
+/// splitmix64, good enough spread for hash keys and simple to run at compile time
+constexpr uint64_t zobrist_random(uint64_t &state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+constexpr ZobristKeys make_zobrist_keys() {
+    ZobristKeys keys{};
+    uint64_t state = 0x5A0B1257ULL;
+    for (auto &piece : keys.pieces) {
+        for (uint64_t &key : piece) {
+            key = zobrist_random(state);
+        }
+    }
+    // each right gets one key and a set of rights is the XOR of its members
+    uint64_t rights[4] = {zobrist_random(state), zobrist_random(state), zobrist_random(state), zobrist_random(state)};
+    for (int set = 0; set < 16; ++set) {
+        for (int bit = 0; bit < 4; ++bit) {
+            if (set & (1 << bit)) {
+                keys.castling[set] ^= rights[bit];
+            }
+        }
+    }
+    for (uint64_t &key : keys.ep_col) {
+        key = zobrist_random(state);
+    }
+    keys.black_to_move = zobrist_random(state);
+    return keys;
+}
+
+inline constexpr ZobristKeys ZOBRIST_KEYS = make_zobrist_keys();
+
+inline uint64_t piece_key(uint8_t piece, int pos) { return ZOBRIST_KEYS.pieces[piece][pos]; }
+inline uint64_t castling_key(uint8_t castling_rights) { return ZOBRIST_KEYS.castling[castling_rights]; }
+/// Key of an en passant tile, 0 when there is none (ep_index == -1)
+inline uint64_t ep_key(int ep_index) { return ep_index == -1 ? 0 : ZOBRIST_KEYS.ep_col[ep_index % 8]; }
+inline uint64_t side_key(bool white_to_move) { return white_to_move ? 0 : ZOBRIST_KEYS.black_to_move; }
@@ -1,8 +1,66 @@
 #include <catch2/catch_test_macros.hpp>
+#include "agent.h"
+#include "batch_eval.h"
+#include "bench.h"
+#include "bitboard.h"
 #include "chessboard.h"
+#include "epd.h"
+#include "nnue.h"
+#include "opening_book.h"
+#include "perft.h"
 #include "piece.h"
+#include "see.h"
+#include "tablebase.h"
+#include "uci.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <stdexcept>
 #include <vector>
 
+// Counts every heap allocation made by the test binary, so tests can check a code path never allocates
+static long allocation_count = 0;
+
+void *operator new(std::size_t size)
+{
+    ++allocation_count;
+    if (void *p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+/// Counts leaf nodes depth moves ahead, generating and making moves in place the way a search does
+static long count_leaves(Chessboard &board, int depth)
+{
+    if (depth == 0) {
+        return 1;
+    }
+    MoveList moves;
+    generate_legal_moves(board, moves);
+    long leaves = 0;
+    for (Move move : moves) {
+        board.make_move(move);
+        leaves += count_leaves(board, depth - 1);
+        board.unmake_move();
+    }
+    return leaves;
+}
+
 TEST_CASE("Move pieces on Chessboard", "[Chessboard]")
 {
     Chessboard board;
@@ -10,18 +68,18 @@ TEST_CASE("Move pieces on Chessboard", "[Chessboard]")
     SECTION("Move pawn to a valid position")
     {
         board.move_piece(48, 40);
-        REQUIRE(board.chessboard.at(40).has_piece() == true);
+        REQUIRE(board.tile(40).has_piece() == true);
     }
 
     SECTION("Attempt to move pawn to an invalid position")
     {
         board.move_piece(49, 16);
-        REQUIRE(board.chessboard.at(16).has_piece() == false);
+        REQUIRE(board.tile(16).has_piece() == false);
     }
 
     SECTION("Confirm the possible moves for a pawn")
     {
-        std::vector<int> possible_moves = board.chessboard.at(55).piece->get_possible_moves(board);
+        std::vector<int> possible_moves = board.tile(55).piece->get_possible_moves(board);
         REQUIRE(possible_moves.at(0) == 55);
         REQUIRE(possible_moves.at(1) == 47);
         REQUIRE(possible_moves.at(2) == 39);
@@ -29,13 +87,1415 @@ TEST_CASE("Move pieces on Chessboard", "[Chessboard]")
 
     SECTION("Confirm two pieces are on the same team")
     {
-        REQUIRE(board.chessboard.at(59).piece->is_opposing_team(board.chessboard.at(3).piece) == true);
+        REQUIRE(board.tile(59).piece->is_opposing_team(board.tile(3).piece) == true);
     }
 
     SECTION("Confirm two pieces are on different teams")
     {
-        REQUIRE(board.chessboard.at(59).piece->is_opposing_team(board.chessboard.at(60).piece) == false);
+        REQUIRE(board.tile(59).piece->is_opposing_team(board.tile(60).piece) == false);
     }
 
     
 }
+
+static bool same_position(const Position &a, const Position &b)
+{
+    return std::memcmp(a.mailbox, b.mailbox, sizeof(a.mailbox)) == 0 &&
+           std::memcmp(a.type_bb, b.type_bb, sizeof(a.type_bb)) == 0 &&
+           std::memcmp(a.team_bb, b.team_bb, sizeof(a.team_bb)) == 0 && a.white_to_move == b.white_to_move &&
+           a.w_king_index == b.w_king_index && a.b_king_index == b.b_king_index && a.w_num_pieces == b.w_num_pieces &&
+           a.b_num_pieces == b.b_num_pieces && a.castling_rights == b.castling_rights && a.ep_index == b.ep_index &&
+           a.key == b.key && a.pawn_key == b.pawn_key && a.psq.mg == b.psq.mg && a.psq.eg == b.psq.eg;
+}
+
+/// Makes and unmakes every move depth plies deep, counting those that don't restore the position and each flag seen
+static long count_unmake_mismatches(Chessboard &board, int depth, int (&flags)[4], int &captures)
+{
+    if (depth == 0) {
+        return 0;
+    }
+    long mismatches = 0;
+    for (Move move : board.get_legal_moves()) {
+        Position before = board;
+        ++flags[move.flag()];
+        captures += !board.is_empty(move.end()) || move.flag() == EN_PASSANT;
+        board.make_move(move);
+        mismatches += count_unmake_mismatches(board, depth - 1, flags, captures);
+        board.unmake_move();
+        mismatches += !same_position(board, before);
+    }
+    return mismatches;
+}
+
+TEST_CASE("Make and unmake restore the position", "[Chessboard]")
+{
+    // Kiwipete (castling, captures, en passant after a double push), promotions both ways, and an en passant capture available at once
+    const char *fens[] = {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+                          "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+                          "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3"};
+    int flags[4] = {0, 0, 0, 0};
+    int captures = 0;
+    for (const char *fen : fens) {
+        Chessboard board{fen};
+        Position start = board;
+        REQUIRE(count_unmake_mismatches(board, 3, flags, captures) == 0);
+        REQUIRE(same_position(board, start));
+        REQUIRE(board.history.empty());
+    }
+
+    // so the walk above is known to have taken back every kind of move
+    REQUIRE(captures > 0);
+    REQUIRE(flags[NORMAL] > 0);
+    REQUIRE(flags[PROMOTION] > 0);
+    REQUIRE(flags[EN_PASSANT] > 0);
+    REQUIRE(flags[CASTLING] > 0);
+}
+
+TEST_CASE("Attack tables match ray walking", "[Bitboard]")
+{
+    auto count_mismatches = []() {
+        int mismatches = 0;
+        uint64_t seed = 0x9E3779B97F4A7C15ULL;
+        for (int i = 0; i < 2000; ++i) {
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            Bitboard occupied = seed & (seed >> 3);  // sparse random blockers
+            for (int pos = 0; pos < 64; ++pos) {
+                mismatches += rook_attacks(pos, occupied) != rook_attacks_slow(pos, occupied);
+                mismatches += bishop_attacks(pos, occupied) != bishop_attacks_slow(pos, occupied);
+            }
+        }
+        return mismatches;
+    };
+
+    SECTION("Magic multiplication indexing")
+    {
+        init_bitboards(false);
+        REQUIRE(count_mismatches() == 0);
+        init_bitboards();
+    }
+
+    SECTION("Default indexing (PEXT when available)")
+    {
+        REQUIRE(count_mismatches() == 0);
+    }
+
+    SECTION("Leaper tables")
+    {
+        REQUIRE(popcount(knight_attacks(0)) == 2);
+        REQUIRE(popcount(knight_attacks(27)) == 8);
+        REQUIRE(popcount(king_attacks(63)) == 3);
+        REQUIRE(pawn_attacks(52, true) == (square_bb(43) | square_bb(45)));
+        REQUIRE(pawn_attacks(8, false) == square_bb(17));
+    }
+}
+
+TEST_CASE("Legal move generation", "[Chessboard]")
+{
+    Chessboard board;
+
+    SECTION("Twenty legal moves from the starting position")
+    {
+        REQUIRE(board.get_legal_moves().size() == 20);
+    }
+
+    SECTION("Fool's mate is checkmate")
+    {
+        REQUIRE(board.move_piece(53, 45));  // f3
+        REQUIRE(board.move_piece(12, 28));  // e5
+        REQUIRE(board.move_piece(54, 38));  // g4
+        REQUIRE(board.move_piece(3, 39));   // Qh4#
+        REQUIRE(board.is_check());
+        REQUIRE(board.is_checkmate());
+    }
+
+    SECTION("A pinned piece can't leave the pin line")
+    {
+        board.move_piece(52, 36);  // e4
+        board.move_piece(11, 27);  // d5
+        board.move_piece(62, 45);  // Nf3
+        board.move_piece(1, 18);   // Nc6
+        board.move_piece(61, 25);  // Bb5, pins the knight on c6
+        REQUIRE(board.is_valid_move(18, 33) == false);
+        REQUIRE(board.is_valid_move(3, 11) == true);
+    }
+
+    SECTION("Castling moves the rook as well")
+    {
+        board.move_piece(52, 36);  // e4
+        board.move_piece(12, 28);  // e5
+        board.move_piece(62, 45);  // Nf3
+        board.move_piece(1, 18);   // Nc6
+        board.move_piece(61, 34);  // Bc4
+        board.move_piece(6, 21);   // Nf6
+        REQUIRE(board.move_piece(60, 62));  // O-O
+        REQUIRE(board.tile(62).piece->type == KING);
+        REQUIRE(board.tile(61).piece->type == ROOK);
+        board.unmake_move();
+        REQUIRE(board.tile(60).piece->type == KING);
+        REQUIRE(board.tile(63).piece->type == ROOK);
+    }
+
+    SECTION("En passant captures the pawn beside the capturing pawn")
+    {
+        board.move_piece(52, 36);  // e4
+        board.move_piece(8, 16);   // a6
+        board.move_piece(36, 28);  // e5
+        board.move_piece(11, 27);  // d5
+        REQUIRE(board.move_piece(28, 19));  // exd6 e.p.
+        REQUIRE(board.tile(27).has_piece() == false);
+        REQUIRE(board.b_num_pieces == 15);
+    }
+}
+
+TEST_CASE("Move generation never allocates", "[Chessboard]")
+{
+    Chessboard board;
+    REQUIRE(sizeof(Move) == 2);
+
+    long before = allocation_count;
+    long leaves = count_leaves(board, 4);
+    long allocations = allocation_count - before;
+
+    REQUIRE(leaves == 197281);
+    REQUIRE(allocations == 0);
+}
+
+/// Walks every line depth moves ahead, counting nodes whose incrementally updated key differs from a full recompute
+static long count_key_mismatches(Chessboard &board, int depth)
+{
+    long mismatches = board.key != board.compute_key() || board.pawn_key != board.compute_pawn_key();
+    if (depth == 0) {
+        return mismatches;
+    }
+    uint64_t key_before = board.key;
+    uint64_t pawn_key_before = board.pawn_key;
+    MoveList moves;
+    generate_legal_moves(board, moves);
+    for (Move move : moves) {
+        board.make_move(move);
+        mismatches += count_key_mismatches(board, depth - 1);
+        board.unmake_move();
+        mismatches += board.key != key_before || board.pawn_key != pawn_key_before;
+    }
+    return mismatches;
+}
+
+TEST_CASE("Zobrist keys", "[Chessboard]")
+{
+    Chessboard board;
+    uint64_t start_key = board.key;
+
+    SECTION("Incremental keys match a full recompute")
+    {
+        REQUIRE(count_key_mismatches(board, 3) == 0);
+        // castling, en passant and promotion all change more than one piece
+        for (auto [start, end] : {std::pair{52, 36}, {8, 16}, {36, 28}, {11, 27}, {28, 19}, {16, 24}, {19, 10}, {24, 32}}) {
+            REQUIRE(board.move_piece(start, end));
+        }
+        REQUIRE(count_key_mismatches(board, 3) == 0);
+    }
+
+    SECTION("Moving the knights out and back gives the starting key")
+    {
+        board.move_piece(62, 45);  // Nf3
+        board.move_piece(6, 21);   // Nf6
+        REQUIRE(board.key != start_key);
+        board.move_piece(45, 62);  // Ng1
+        board.move_piece(21, 6);   // Ng8
+        REQUIRE(board.key == start_key);
+    }
+
+    SECTION("Transpositions share a key")
+    {
+        board.move_piece(52, 36);  // e4
+        board.move_piece(12, 28);  // e5
+        board.move_piece(62, 45);  // Nf3
+        Chessboard other;
+        other.move_piece(62, 45);  // Nf3
+        other.move_piece(12, 28);  // e5
+        other.move_piece(52, 36);  // e4
+        REQUIRE(board.key == other.key);
+    }
+
+    SECTION("Side to move and lost castling rights change the key")
+    {
+        board.move_piece(52, 36);  // e4
+        board.move_piece(12, 28);  // e5
+        board.move_piece(60, 52);  // Ke2
+        board.move_piece(4, 12);   // Ke7
+        board.move_piece(52, 60);  // Ke1
+        board.move_piece(12, 4);   // Ke8
+        Chessboard other;
+        other.move_piece(52, 36);  // e4
+        other.move_piece(12, 28);  // e5
+        REQUIRE(board.compute_key() == board.key);
+        REQUIRE(board.key != other.key);
+    }
+}
+
+/// Walks every line depth moves ahead, counting nodes whose incrementally updated psq score differs from a full recompute
+static long count_psq_mismatches(Chessboard &board, int depth)
+{
+    long mismatches = board.psq != board.compute_psq();
+    if (depth == 0) {
+        return mismatches;
+    }
+    PsqScore psq_before = board.psq;
+    MoveList moves;
+    generate_legal_moves(board, moves);
+    for (Move move : moves) {
+        board.make_move(move);
+        mismatches += count_psq_mismatches(board, depth - 1);
+        board.unmake_move();
+        mismatches += board.psq != psq_before;
+    }
+    return mismatches;
+}
+
+TEST_CASE("Incremental piece-square score", "[Chessboard]")
+{
+    Chessboard board;
+
+    SECTION("The starting position is even")
+    {
+        REQUIRE(board.psq == PsqScore{});
+    }
+
+    SECTION("Incremental scores match a full recompute")
+    {
+        REQUIRE(count_psq_mismatches(board, 3) == 0);
+        // castling, en passant and promotion all change more than one piece
+        for (auto [start, end] : {std::pair{52, 36}, {8, 16}, {36, 28}, {11, 27}, {28, 19}, {16, 24}, {19, 10}, {24, 32}}) {
+            REQUIRE(board.move_piece(start, end));
+        }
+        REQUIRE(count_psq_mismatches(board, 3) == 0);
+    }
+
+    SECTION("Captures change the score by the captured piece")
+    {
+        board.move_piece(52, 36);  // e4
+        board.move_piece(11, 27);  // d5
+        PsqScore before = board.psq;
+        board.move_piece(36, 27);  // exd5
+        REQUIRE(board.psq == before + psq_score(make_piece(PAWN, true), 27) - psq_score(make_piece(PAWN, true), 36) -
+                                 psq_score(make_piece(PAWN, false), 27));
+        REQUIRE(board.psq.mg < before.mg);  // white won a pawn, worse for black
+    }
+
+    SECTION("Black's tables mirror white's")
+    {
+        for (int type = PAWN; type <= QUEEN; ++type) {
+            for (int pos = 0; pos < 64; ++pos) {
+                REQUIRE(psq_score(make_piece(Type(type), false), pos) == -psq_score(make_piece(Type(type), true), pos ^ 56));
+            }
+        }
+    }
+
+    SECTION("The game phase tapers from the middle game to the end game")
+    {
+        REQUIRE(board.game_phase() == MAX_PHASE);
+        REQUIRE(taper(board.psq, board.game_phase()) == board.psq.mg);
+
+        board.clear_pieces();
+        board.put_piece(4, KING, false);
+        board.put_piece(60, KING, true);
+        board.put_piece(52, PAWN, true);
+        REQUIRE(board.game_phase() == 0);
+        REQUIRE(taper(board.psq, board.game_phase()) == board.psq.eg);
+        board.put_piece(3, ROOK, false);
+        REQUIRE(board.game_phase() == PHASE_WEIGHTS[ROOK]);
+
+        // a king in the centre is worth more as material comes off
+        PsqScore centre = psq_score(make_piece(KING, true), 35);
+        PsqScore corner = psq_score(make_piece(KING, true), 62);
+        REQUIRE(-centre.mg < -corner.mg);
+        REQUIRE(-centre.eg > -corner.eg);
+    }
+}
+
+TEST_CASE("Pawn table", "[Agent]")
+{
+    Chessboard board;
+    PawnTable table{64};
+
+    SECTION("Only pawn moves change the pawn key")
+    {
+        uint64_t start_pawn_key = board.pawn_key;
+        board.move_piece(62, 45);  // Nf3
+        REQUIRE(board.pawn_key == start_pawn_key);
+        board.move_piece(12, 28);  // e5
+        REQUIRE(board.pawn_key != start_pawn_key);
+    }
+
+    SECTION("Probing the same pawns again is a hit")
+    {
+        table.probe(board);
+        REQUIRE(table.misses() == 1);
+        board.move_piece(62, 45);  // Nf3
+        board.move_piece(6, 21);   // Nf6
+        const PawnEntry &entry = table.probe(board);
+        REQUIRE(table.hits() == 1);
+        REQUIRE(entry.pawn_key == board.pawn_key);
+        REQUIRE(entry.score == PsqScore{});  // the starting pawns are even
+        REQUIRE(entry.open_files == 0);
+        REQUIRE(table.hit_rate() == 500);
+    }
+
+    SECTION("Doubled, isolated and passed pawns")
+    {
+        board.clear_pieces();
+        board.put_piece(4, KING, false);
+        board.put_piece(60, KING, true);
+        board.put_piece(52, PAWN, true);  // e2
+        board.put_piece(44, PAWN, true);  // e3, doubled and isolated with e2
+        board.put_piece(14, PAWN, false);  // g7, passed and isolated
+        PawnEntry entry = PawnTable::evaluate(board);
+        REQUIRE(entry.passed[false] == square_bb(14));
+        REQUIRE(entry.passed[true] == square_bb(44));  // e2 is stuck behind e3, only the front pawn is passed
+        REQUIRE(entry.open_files == uint8_t(~(1 << 4 | 1 << 6)));
+        REQUIRE(entry.semi_open_files[true] == uint8_t(~(1 << 4)));
+
+        // the same pawns with colours swapped and the board flipped score the same for the other team
+        Chessboard flipped;
+        flipped.clear_pieces();
+        flipped.put_piece(4 ^ 56, KING, true);
+        flipped.put_piece(60 ^ 56, KING, false);
+        flipped.put_piece(52 ^ 56, PAWN, false);
+        flipped.put_piece(44 ^ 56, PAWN, false);
+        flipped.put_piece(14 ^ 56, PAWN, true);
+        REQUIRE(PawnTable::evaluate(flipped).score == -entry.score);
+    }
+}
+
+TEST_CASE("Transposition table", "[Agent]")
+{
+    TranspositionTable tt(1);
+    TTEntry entry;
+    Move move{52, 36};
+
+    SECTION("Stored results are found again")
+    {
+        tt.store(0x1234567890ABCDEFULL, 5, BOUND_LOWER, -250, move);
+        REQUIRE(tt.probe(0x1234567890ABCDEFULL, entry));
+        REQUIRE(entry.move == move);
+        REQUIRE(entry.score == -250);
+        REQUIRE(entry.depth == 5);
+        REQUIRE(entry.bound == BOUND_LOWER);
+        REQUIRE(tt.probe(0x1234567890ABCDEEULL, entry) == false);
+    }
+
+    SECTION("The table is a power of two number of cache lines")
+    {
+        tt.resize(3);
+        REQUIRE(tt.size_mb() == 2);
+        tt.store(42, 1, BOUND_EXACT, 0, move);
+        tt.clear();
+        REQUIRE(tt.probe(42, entry) == false);
+    }
+
+    SECTION("Older and shallower entries are replaced first")
+    {
+        // every key below lands in bucket 0, which holds four entries
+        uint64_t step = uint64_t(1) << 40;
+        for (int i = 1; i <= 4; ++i) {
+            tt.store(i * step, 10 + i, BOUND_EXACT, i, move);
+        }
+        tt.new_search();
+        tt.store(5 * step, 1, BOUND_EXACT, 5, move);
+        REQUIRE(tt.probe(5 * step, entry));
+        REQUIRE(tt.probe(1 * step, entry) == false);
+        REQUIRE(tt.probe(4 * step, entry));
+    }
+
+    SECTION("Mate scores are stored relative to the position")
+    {
+        int mate_in_3_from_root = MATE_SCORE - 5;
+        int stored = score_to_tt(mate_in_3_from_root, 2);
+        REQUIRE(stored == MATE_SCORE - 3);
+        REQUIRE(score_from_tt(stored, 4) == MATE_SCORE - 7);
+        REQUIRE(score_from_tt(score_to_tt(-mate_in_3_from_root, 2), 4) == -(MATE_SCORE - 7));
+        REQUIRE(score_to_tt(150, 9) == 150);
+    }
+}
+
+TEST_CASE("Evaluation cache", "[Agent]")
+{
+    EvalCache cache(1);
+    int score = 0;
+
+    SECTION("Stored scores are found again")
+    {
+        cache.store(0x1234567890ABCDEFULL, -1234);
+        REQUIRE(cache.probe(0x1234567890ABCDEFULL, score));
+        REQUIRE(score == -1234);
+        REQUIRE(cache.probe(0x1234567890ABCDEFULL ^ (uint64_t(1) << 40), score) == false);  // same slot, another position
+        cache.clear();
+        REQUIRE(cache.probe(0x1234567890ABCDEFULL, score) == false);
+    }
+
+    SECTION("The cache is sized apart from the transposition table")
+    {
+        cache.resize(3);
+        REQUIRE(cache.size_mb() == 2);
+    }
+
+    SECTION("The search is the same with or without it, and repeats are found in it")
+    {
+        Chessboard board;
+        board.move_piece(52, 36);  // e4
+        board.move_piece(12, 28);  // e5
+        SearchLimits limits;
+        limits.depth = 6;
+        Agent cached{board};
+        Agent uncached{board};
+        uncached.options.eval_cache = false;
+        SearchResult with_cache = cached.search(limits);
+        SearchResult without_cache = uncached.search(limits);
+        REQUIRE(with_cache.best_move == without_cache.best_move);
+        REQUIRE(with_cache.score == without_cache.score);
+        REQUIRE(with_cache.nodes == without_cache.nodes);
+        REQUIRE(without_cache.eval_cache_hits + without_cache.eval_cache_misses == 0);
+        REQUIRE(with_cache.eval_cache_hits > 0);
+    }
+}
+
+/// Random network shared by the NNUE tests, building one takes a moment
+static std::shared_ptr<NnueNetwork> test_network()
+{
+    static std::shared_ptr<NnueNetwork> network = [] {
+        std::shared_ptr<NnueNetwork> random_network{new NnueNetwork()};
+        random_network->randomize(1);
+        return random_network;
+    }();
+    return network;
+}
+
+/// Walks every line depth moves ahead updating accumulators incrementally, counting nodes where they differ from a refresh
+static long count_accumulator_mismatches(Chessboard &board, const NnueNetwork &network, NnueAccumulator *stack, int depth)
+{
+    NnueAccumulator refreshed;
+    network.refresh(board, refreshed);
+    long mismatches = std::memcmp(refreshed.values, stack[0].values, sizeof(refreshed.values)) != 0;
+    if (depth == 0) {
+        return mismatches;
+    }
+    MoveList moves;
+    generate_legal_moves(board, moves);
+    for (Move move : moves) {
+        NnueDirty dirty = nnue_dirty(board, move);
+        board.make_move(move);
+        network.update(stack[0], stack[1], board, dirty);
+        mismatches += count_accumulator_mismatches(board, network, stack + 1, depth - 1);
+        board.unmake_move();
+    }
+    return mismatches;
+}
+
+TEST_CASE("NNUE evaluation", "[Agent]")
+{
+    std::shared_ptr<NnueNetwork> network = test_network();
+    Chessboard board;
+    // castling, en passant and promotion are all a move or two away
+    for (auto [start, end] : {std::pair{52, 36}, {8, 16}, {36, 28}, {11, 27}, {28, 19}, {16, 24}, {19, 10}, {24, 32}}) {
+        REQUIRE(board.move_piece(start, end));
+    }
+
+    SECTION("Incremental accumulators match a refresh with every kernel")
+    {
+        for (int level = SIMD_SCALAR; level <= best_simd_level(); ++level) {
+            network->set_simd_level(SimdLevel(level));
+            std::vector<NnueAccumulator> stack(4);
+            network->refresh(board, stack[0]);
+            REQUIRE(count_accumulator_mismatches(board, *network, stack.data(), 3) == 0);
+        }
+        network->set_simd_level(best_simd_level());
+    }
+
+    SECTION("Every kernel gives the same score")
+    {
+        network->set_simd_level(SIMD_SCALAR);
+        int scalar = network->evaluate(board);
+        for (int level = SIMD_SSE41; level <= best_simd_level(); ++level) {
+            network->set_simd_level(SimdLevel(level));
+            REQUIRE(network->evaluate(board) == scalar);
+        }
+        network->set_simd_level(best_simd_level());
+    }
+
+    SECTION("Weights survive a save and load")
+    {
+        network->save("nnue_test.bin");
+        std::unique_ptr<NnueNetwork> loaded = NnueNetwork::load("nnue_test.bin");
+        REQUIRE(loaded->evaluate(board) == network->evaluate(board));
+        std::remove("nnue_test.bin");
+    }
+
+    SECTION("Missing and foreign files are rejected")
+    {
+        REQUIRE_THROWS_AS(NnueNetwork::load("missing.nnue"), std::runtime_error);
+        std::ofstream{"foreign.nnue"} << "not a network";
+        REQUIRE_THROWS_AS(NnueNetwork::load("foreign.nnue"), std::runtime_error);
+        std::remove("foreign.nnue");
+    }
+
+    SECTION("Scores of a network with an extreme bias stay short of a mate")
+    {
+        network->save("nnue_test.bin");
+        for (int32_t bias : {1000000000, -1000000000}) {
+            {
+                // the output bias is the int32 just before the last NNUE_L3 output weights
+                std::fstream file{"nnue_test.bin", std::ios::in | std::ios::out | std::ios::binary};
+                file.seekp(-std::streamoff(NNUE_L3 + sizeof(bias)), std::ios::end);
+                file.write(reinterpret_cast<const char *>(&bias), sizeof(bias));
+            }
+            std::shared_ptr<NnueNetwork> loaded{NnueNetwork::load("nnue_test.bin")};
+            REQUIRE(std::abs(loaded->evaluate(board)) >= MATE_BOUND);
+
+            Agent agent{board};
+            agent.set_network(loaded);
+            SearchLimits limits;
+            limits.depth = 1;
+            SearchResult evaluated = agent.search(limits);
+            agent.tt.clear();
+            SearchResult cached = agent.search(limits);  // the same evaluations again, now from the EvalCache
+            REQUIRE(cached.eval_cache_hits > 0);
+            REQUIRE(std::abs(evaluated.score) == MATE_BOUND - 1);  // every position is scored as far as it can go
+            REQUIRE(cached.score == evaluated.score);
+        }
+        std::remove("nnue_test.bin");
+    }
+
+    SECTION("The agent searches with a network, and without it again")
+    {
+        Agent agent{board};
+        SearchLimits limits;
+        limits.depth = 4;
+        SearchResult classic = agent.search(limits);
+        agent.set_network(network);
+        SearchResult nnue = agent.search(limits);
+        REQUIRE(nnue.best_move);
+        REQUIRE(nnue.score != classic.score);
+        agent.set_network(nullptr);
+        agent.tt.clear();
+        limits.depth = 1;  // no history or killers to carry over from the searches before
+        Agent fresh{board};
+        REQUIRE(agent.search(limits).score == fresh.search(limits).score);
+    }
+}
+
+/// Packs every position depth moves ahead into positions, with the score Position::psq tapers to in expected
+static void collect_packed(Chessboard &board, std::vector<PackedPosition> &positions, std::vector<int> &expected, int depth)
+{
+    positions.push_back(pack_position(board));
+    expected.push_back(taper(board.psq, board.game_phase()));
+    if (depth == 0) {
+        return;
+    }
+    MoveList moves;
+    generate_legal_moves(board, moves);
+    for (Move move : moves) {
+        board.make_move(move);
+        collect_packed(board, positions, expected, depth - 1);
+        board.unmake_move();
+    }
+}
+
+TEST_CASE("Batch evaluation", "[Agent]")
+{
+    Chessboard board;
+    for (auto [start, end] : {std::pair{52, 36}, {8, 16}, {36, 28}, {11, 27}, {28, 19}, {16, 24}, {19, 10}, {24, 32}}) {
+        REQUIRE(board.move_piece(start, end));
+    }
+    std::vector<PackedPosition> positions;
+    std::vector<int> expected;
+    collect_packed(board, positions, expected, 2);
+    std::vector<int> scores(positions.size());
+
+    SECTION("Every kernel matches the incremental score")
+    {
+        for (int level = SIMD_SCALAR; level <= best_simd_level(); ++level) {
+            std::fill(scores.begin(), scores.end(), 0);
+            evaluate_batch(positions.data(), positions.size(), scores.data(), SimdLevel(level));
+            REQUIRE(scores == expected);
+        }
+    }
+
+    SECTION("Batches that don't fill a block")
+    {
+        evaluate_batch(positions.data(), 13, scores.data());
+        REQUIRE(std::equal(scores.begin(), scores.begin() + 13, expected.begin()));
+    }
+
+    SECTION("Threads split the batch without changing it")
+    {
+        for (int threads : {1, 3, 8}) {
+            std::fill(scores.begin(), scores.end(), 0);
+            evaluate_batch_parallel(positions.data(), positions.size(), scores.data(), threads);
+            REQUIRE(scores == expected);
+        }
+    }
+}
+
+/// Empty board with both kings and one white piece of type, false if the pieces overlap or the team not to move is in check
+static bool place_three(Chessboard &board, int wk, int bk, int pos, Type type, bool white_to_move)
+{
+    if (wk == bk || wk == pos || bk == pos || (type == PAWN && (pos < 8 || pos >= 56))) {
+        return false;
+    }
+    board.clear_pieces();
+    board.put_piece(wk, KING, true);
+    board.put_piece(bk, KING, false);
+    board.put_piece(pos, type, true);
+    board.white_to_move = white_to_move;
+    board.key = board.compute_key();
+    return !board.is_attacked(board.king_index(!white_to_move), white_to_move);
+}
+
+/// Orders results from the point of view of the team to move, quicker wins and slower losses first
+static int tb_rank(const TbProbe &probe)
+{
+    return probe.result == TB_WIN ? 1000 - probe.plies : probe.result == TB_LOSS ? -1000 + probe.plies : 0;
+}
+
+/// Counts the positions with a white piece of type whose stored result isn't the one their best move leads to
+static long count_tablebase_inconsistencies(const Tablebase &tablebase, Type type)
+{
+    long wrong = 0;
+    Chessboard board;
+    for (int wk = 0; wk < 64; ++wk) {
+        for (int bk = 0; bk < 64; ++bk) {
+            for (int pos = 0; pos < 64; ++pos) {
+                for (bool white_to_move : {true, false}) {
+                    if (!place_three(board, wk, bk, pos, type, white_to_move)) {
+                        continue;
+                    }
+                    TbProbe stored;
+                    if (!tablebase.probe(board, stored)) {
+                        ++wrong;
+                        continue;
+                    }
+                    TbProbe expected;
+                    MoveList moves = board.get_legal_moves();
+                    if (moves.empty()) {
+                        expected.result = board.is_check() ? TB_LOSS : TB_DRAW;
+                    } else {
+                        expected.result = TB_LOSS;
+                        expected.plies = 0;
+                        int best = -10000;
+                        for (Move move : moves) {
+                            board.make_move(move);
+                            TbProbe child;
+                            wrong += !tablebase.probe(board, child);
+                            board.unmake_move();
+                            TbProbe result{TbResult(-child.result), child.result == TB_DRAW ? 0 : child.plies + 1};
+                            if (tb_rank(result) > best) {
+                                best = tb_rank(result);
+                                expected = result;
+                            }
+                        }
+                    }
+                    wrong += stored.result != expected.result || stored.plies != expected.plies;
+                }
+            }
+        }
+    }
+    return wrong;
+}
+
+TEST_CASE("Endgame tablebase", "[Agent]")
+{
+    static std::shared_ptr<Tablebase> tablebase = [] {
+        std::shared_ptr<Tablebase> generated{new Tablebase()};
+        generated->generate(".", 3, 2);
+        return generated;
+    }();
+    REQUIRE(tablebase->table_count() == 5);
+    REQUIRE(tablebase->max_pieces() == 3);
+
+    SECTION("Every position's result follows from its moves")
+    {
+        REQUIRE(count_tablebase_inconsistencies(*tablebase, ROOK) == 0);
+        REQUIRE(count_tablebase_inconsistencies(*tablebase, PAWN) == 0);
+    }
+
+    SECTION("Known results")
+    {
+        Chessboard board;
+        TbProbe result;
+        REQUIRE(place_three(board, 60, 4, 56, QUEEN, true));
+        REQUIRE(tablebase->probe(board, result));
+        REQUIRE(result.result == TB_WIN);
+        REQUIRE(place_three(board, 60, 4, 56, KNIGHT, true));
+        REQUIRE(tablebase->probe(board, result));
+        REQUIRE(result.result == TB_DRAW);
+        // black to move takes the undefended rook
+        REQUIRE(place_three(board, 63, 1, 9, ROOK, false));
+        REQUIRE(tablebase->probe(board, result));
+        REQUIRE(result.result == TB_DRAW);
+        // the longest mate with a queen is 10 moves
+        int longest = 0;
+        for (int bk = 0; bk < 64; ++bk) {
+            for (int pos = 0; pos < 64; ++pos) {
+                if (place_three(board, 56, bk, pos, QUEEN, true) && tablebase->probe(board, result)) {
+                    longest = std::max(longest, result.plies);
+                }
+            }
+        }
+        REQUIRE(longest <= 19);
+    }
+
+    SECTION("Mapped files give the same results")
+    {
+        Tablebase mapped;
+        REQUIRE(mapped.load(".") == 5);
+        Chessboard board;
+        for (int pos : {17, 27, 42, 54}) {
+            REQUIRE(place_three(board, 36, 2, pos, PAWN, pos < 32));
+            TbProbe generated_result, mapped_result;
+            REQUIRE(tablebase->probe(board, generated_result));
+            REQUIRE(mapped.probe(board, mapped_result));
+            REQUIRE(mapped_result.result == generated_result.result);
+            REQUIRE(mapped_result.plies == generated_result.plies);
+        }
+        for (const char *name : {"KQvK", "KRvK", "KBvK", "KNvK", "KPvK"}) {
+            std::remove((std::string(name) + ".ctb").c_str());
+        }
+    }
+
+    SECTION("The agent scores table positions as mates")
+    {
+        Chessboard board;
+        REQUIRE(place_three(board, 60, 4, 56, ROOK, true));
+        TbProbe result;
+        REQUIRE(tablebase->probe(board, result));
+        Agent agent{board};
+        agent.tablebase = tablebase;
+        SearchLimits limits;
+        limits.depth = 1;
+        SearchResult search = agent.search(limits);
+        REQUIRE(search.tb_hits > 0);
+        REQUIRE(search.score == MATE_SCORE - result.plies);
+    }
+
+    SECTION("Table mates probed deep in the search are still mates")
+    {
+        // the longest queen mate, probed near the deepest ply a search can reach
+        Chessboard board;
+        TbProbe result, longest;
+        for (int bk = 0; bk < 64; ++bk) {
+            for (int pos = 0; pos < 64; ++pos) {
+                if (place_three(board, 56, bk, pos, QUEEN, true) && tablebase->probe(board, result) && result.plies > longest.plies) {
+                    longest = result;
+                }
+            }
+        }
+        REQUIRE(longest.result == TB_WIN);
+        int ply = MAX_PLY - 2;
+        REQUIRE(ply + longest.plies > MAX_PLY);
+        int score = mate_in(ply, longest.plies);
+        REQUIRE(score >= MATE_BOUND);
+        REQUIRE(mate_in(0, longest.plies) == MATE_SCORE - longest.plies);
+
+        // and stay mates through the transposition table, whatever ply they come back at
+        TranspositionTable tt{1};
+        tt.store(board.key, 1, BOUND_EXACT, score_to_tt(-score, ply), Move());
+        TTEntry entry;
+        REQUIRE(tt.probe(board.key, entry));
+        for (int probe_ply : {0, ply, MAX_PLY - 1}) {
+            REQUIRE(score_from_tt(entry.score, probe_ply) <= -MATE_BOUND);
+        }
+    }
+}
+
+/// Appends one 16 byte Polyglot entry for a move between Polyglot tile numbers (a1 is 0) to book
+static void add_book_entry(std::vector<uint8_t> &book, uint64_t key, int from, int to, uint16_t weight)
+{
+    uint16_t move = uint16_t(to | from << 6);
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        book.push_back(uint8_t(key >> shift));
+    }
+    book.insert(book.end(), {uint8_t(move >> 8), uint8_t(move), uint8_t(weight >> 8), uint8_t(weight), 0, 0, 0, 0});
+}
+
+TEST_CASE("Opening book", "[Agent]")
+{
+    SECTION("Keys match the Polyglot reference keys")
+    {
+        Chessboard board;
+        REQUIRE(polyglot_key(board) == 0x463b96181691fc9cULL);
+        const std::pair<int, int> moves[] = {{52, 36}, {11, 27}, {36, 28}, {13, 29}, {60, 52}, {4, 13}};
+        const uint64_t keys[] = {0x823c9b50fd114196ULL, 0x0756b94461c50fb0ULL, 0x662fafb965db29d4ULL,
+                                 0x22a48b5a8e47ff78ULL, 0x652a607ca3f242c1ULL, 0x00fdd303c946bdd9ULL};
+        for (int i = 0; i < 6; ++i) {
+            REQUIRE(board.move_piece(moves[i].first, moves[i].second));
+            REQUIRE(polyglot_key(board) == keys[i]);
+        }
+
+        Chessboard other;
+        for (auto [start, end] : {std::pair{48, 32}, {9, 25}, {55, 39}, {25, 33}, {50, 34}}) {
+            REQUIRE(other.move_piece(start, end));
+        }
+        REQUIRE(polyglot_key(other) == 0x3c8123ea7b067637ULL);
+        REQUIRE(other.move_piece(33, 42));  // en passant
+        REQUIRE(other.move_piece(56, 40));
+        REQUIRE(polyglot_key(other) == 0x5c3f9b829b279560ULL);
+    }
+
+    SECTION("Book moves are found and checked against the legal moves")
+    {
+        Chessboard start;
+        Chessboard castle;
+        for (auto [from, to] : {std::pair{52, 36}, {12, 28}, {62, 45}, {1, 18}, {61, 34}, {5, 26}}) {
+            REQUIRE(castle.move_piece(from, to));
+        }
+        // entries sorted by key, with others around them for the binary search to skip
+        std::vector<std::pair<uint64_t, std::vector<uint8_t>>> entries;
+        auto add = [&](uint64_t key, int from, int to, uint16_t weight) {
+            entries.emplace_back(key, std::vector<uint8_t>{});
+            add_book_entry(entries.back().second, key, from, to, weight);
+        };
+        for (uint64_t key : {1ULL, 0x4000000000000000ULL, 0x9000000000000000ULL, 0xFFFFFFFFFFFFFFFFULL}) {
+            add(key, 12, 28, 1);
+        }
+        add(polyglot_key(start), 12, 28, 30);   // e2e4
+        add(polyglot_key(start), 11, 27, 10);   // d2d4
+        add(polyglot_key(start), 12, 36, 100);  // e2e5 isn't legal
+        add(polyglot_key(castle), 4, 7, 1);     // e1h1 is castling king side
+        std::stable_sort(entries.begin(), entries.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+        {
+            std::ofstream file{"test_book.bin", std::ios::binary};
+            for (const auto &entry : entries) {
+                file.write(reinterpret_cast<const char *>(entry.second.data()), entry.second.size());
+            }
+        }
+
+        OpeningBook book;
+        REQUIRE(book.load("test_book.bin"));
+        std::remove("test_book.bin");
+        REQUIRE(book.size() == 8);
+        REQUIRE(book.moves(start).size() == 2);
+        REQUIRE(book.pick(start, BOOK_BEST) == Move(52, 36));
+        for (uint64_t random = 0; random < 40; ++random) {
+            REQUIRE(book.pick(start, BOOK_WEIGHTED, random) == (random < 30 ? Move(52, 36) : Move(51, 35)));
+        }
+        REQUIRE(book.pick(castle, BOOK_BEST) == Move(60, 62, CASTLING));
+        REQUIRE(start.move_piece(51, 35));
+        REQUIRE_FALSE(book.pick(start, BOOK_BEST));
+    }
+
+    SECTION("Files that aren't books are refused")
+    {
+        OpeningBook book;
+        REQUIRE_FALSE(book.load("missing_book.bin"));
+        {
+            std::ofstream file{"test_book.bin", std::ios::binary};
+            file << "not a whole entry";
+        }
+        REQUIRE_FALSE(book.load("test_book.bin"));
+        std::remove("test_book.bin");
+        REQUIRE(book.size() == 0);
+    }
+}
+
+/// Offset of the FenError set_fen() throws for fen, or -1 if it doesn't throw
+static long fen_error_offset(Chessboard &board, const std::string &fen)
+{
+    try {
+        board.set_fen(fen);
+    } catch (const FenError &error) {
+        return long(error.offset);
+    }
+    return -1;
+}
+
+TEST_CASE("FEN and EPD", "[Chessboard]")
+{
+    const std::string kiwipete = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+
+    SECTION("Positions round trip and match the ones reached by moves")
+    {
+        Chessboard start;
+        REQUIRE(start.fen() == "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+        REQUIRE(Chessboard(start.fen()).key == start.key);
+        REQUIRE(Chessboard(kiwipete).fen() == kiwipete);
+
+        for (auto [from, to] : {std::pair{52, 36}, {11, 27}, {36, 28}, {13, 29}}) {
+            REQUIRE(start.move_piece(from, to));
+        }
+        Chessboard loaded{"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3"};
+        REQUIRE(loaded.key == start.key);
+        REQUIRE(loaded.pawn_key == start.pawn_key);
+        REQUIRE(loaded.fen(false) == start.fen(false));
+        REQUIRE(loaded.fen(false) == "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6");
+        // no pawn can take on e3, so it is dropped like make_move() does
+        REQUIRE(Chessboard("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1").ep_index == -1);
+    }
+
+    SECTION("Errors give the offset of the problem and leave the board alone")
+    {
+        Chessboard board{kiwipete};
+        uint64_t key = board.key;
+        std::string bad_piece = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNX w KQkq - 0 1";
+        REQUIRE(fen_error_offset(board, bad_piece) == long(bad_piece.find('X')));
+        REQUIRE(fen_error_offset(board, "8/8/8 w - -") == 5);
+        REQUIRE(fen_error_offset(board, "4k3/8/8/8/8/8/8/4K3 x - - 0 1") == 20);
+        REQUIRE(fen_error_offset(board, "4k3/8/8/8/8/8/8/4R1K1 w - - 0 1") == 22);  // black is in check on white's turn
+        REQUIRE(fen_error_offset(board, "4k3/8/8/8/8/8/8/4K3 w - e4 0 1") == 24);
+        REQUIRE(fen_error_offset(board, "4k3/8/8/8/8/8/8/4K3 w - - 0 1 extra") == 30);
+        REQUIRE(fen_error_offset(board, "4k3/8/8/8/8/8/8/8 w - -") == 17);
+        REQUIRE(board.key == key);
+        REQUIRE(board.fen() == kiwipete);
+        REQUIRE(fen_error_offset(board, "4k3/8/8/8/8/8/8/4K3 w - -") == -1);
+    }
+
+    SECTION("Parsing doesn't allocate")
+    {
+        Chessboard board;
+        long before = allocation_count;
+        board.set_fen(kiwipete);
+        REQUIRE(allocation_count == before);
+    }
+
+    SECTION("SAN round trips and names the start tile only when needed")
+    {
+        for (const char *fen : {kiwipete.c_str(), "4k3/8/8/8/8/8/K7/R6R w - - 0 1", "4k3/R7/8/8/8/8/1K6/R7 w - - 0 1",
+                                "1n2k3/P7/8/3pP3/8/8/8/4K3 w - d6 0 1"}) {
+            Chessboard board{fen};
+            for (Move move : board.get_legal_moves()) {
+                REQUIRE(move_from_san(board, move_to_san(board, move)) == move);
+            }
+        }
+        REQUIRE(move_to_san(Chessboard("4k3/8/8/8/8/8/K7/R6R w - - 0 1"), Move(56, 60)) == "Rae1+");
+        REQUIRE(move_to_san(Chessboard("4k3/R7/8/8/8/8/1K6/R7 w - - 0 1"), Move(56, 32)) == "R1a4");
+        Chessboard promotions{"1n2k3/P7/8/3pP3/8/8/8/4K3 w - d6 0 1"};
+        REQUIRE(move_from_san(promotions, "axb8=Q+") == Move(8, 1, PROMOTION, QUEEN));
+        REQUIRE(move_from_san(promotions, "exd6") == Move(28, 19, EN_PASSANT));
+        REQUIRE(move_from_san(Chessboard(kiwipete), "O-O-O") == Move(60, 58, CASTLING));
+        REQUIRE_FALSE(move_from_san(promotions, "a8"));  // a promotion needs its piece
+        REQUIRE_FALSE(move_from_san(Chessboard(kiwipete), "Kd3"));  // not legal
+    }
+
+    SECTION("EPD records and suites")
+    {
+        const std::string line = "6k1/5ppp/8/8/8/8/8/R5K1 w - - bm Ra8#; am Ra7; c0 \"comment; with a semicolon\"; id \"mate.1\";";
+        EpdRecord record = parse_epd(line);
+        REQUIRE(record.id == "mate.1");
+        REQUIRE(record.best_moves == std::vector<Move>{Move(56, 0)});
+        REQUIRE(record.avoid_moves == std::vector<Move>{Move(56, 8)});
+        REQUIRE(to_epd(record) == "6k1/5ppp/8/8/8/8/8/R5K1 w - - bm Ra8#; am Ra7; id \"mate.1\";");
+
+        for (auto [bad, offset] : {std::pair{"6k1/5ppp/8/8/8/8/8/R5K1 w - - bm Rb9;", 33}, {"6k1/5ppp/8/8/8/8/8/R5K1 w - - bm Ra8", 36},
+                                   {"6k1/5ppp/8/8/8/8/8/R5K1 w - - id \"open;", 33}, {"6k1/5ppp/8/8/8/8/8/R5K1 w - - 7;", 30}}) {
+            try {
+                parse_epd(bad);
+                FAIL("no FenError for " << bad);
+            } catch (const FenError &error) {
+                REQUIRE(error.offset == size_t(offset));
+            }
+        }
+
+        std::vector<EpdRecord> suite = {record, parse_epd("2rr3k/pp3pp1/1nnqbN1p/3pN3/2pP4/2P3Q1/PPB4P/R4RK1 w - - bm Qg6; id \"WAC.001\";"),
+                                        parse_epd("6k1/5ppp/8/8/8/8/8/R5K1 w - - am Ra8#;")};
+        Agent agent{Chessboard()};
+        SearchLimits limits;
+        limits.depth = 4;
+        EpdSuiteResult result = run_epd_suite(agent, suite, limits);
+        REQUIRE(result.positions == 3);
+        REQUIRE(result.solved == 2);
+        REQUIRE(result.nodes > 0);
+    }
+}
+
+TEST_CASE("Perft", "[Chessboard]")
+{
+    // reference counts from https://www.chessprogramming.org/Perft_Results
+    struct Reference {
+        const char *fen;
+        std::vector<uint64_t> counts;  // depth 1 upwards
+    };
+    const std::vector<Reference> references = {
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", {20, 400, 8902, 197281, 4865609}},
+        {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", {48, 2039, 97862, 4085603}},
+        {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", {14, 191, 2812, 43238, 674624}},
+        {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", {6, 264, 9467, 422333}},
+        {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", {44, 1486, 62379, 2103487}},
+        {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", {46, 2079, 89890, 3894594}},
+    };
+
+    SECTION("Reference positions give their known counts")
+    {
+        for (const Reference &reference : references) {
+            Chessboard board{reference.fen};
+            for (size_t depth = 1; depth <= reference.counts.size(); ++depth) {
+                REQUIRE(perft(board, int(depth)) == reference.counts[depth - 1]);
+            }
+            REQUIRE(board.fen() == Chessboard(reference.fen).fen());
+        }
+    }
+
+    SECTION("Threads and the hash give the same counts")
+    {
+        PerftHash hash{16};
+        for (const Reference &reference : references) {
+            Chessboard board{reference.fen};
+            int depth = int(reference.counts.size());
+            PerftResult result = perft_divide(board, depth, 4, &hash);
+            REQUIRE(result.nodes == reference.counts.back());
+            REQUIRE(result.divide.size() == reference.counts.front());
+            for (const auto &[move, count] : result.divide) {
+                board.make_move(move);
+                REQUIRE(count == perft(board, depth - 1));
+                board.unmake_move();
+            }
+        }
+    }
+
+    SECTION("A small hash still counts correctly")
+    {
+        PerftHash hash{1};
+        Chessboard board{references[1].fen};
+        REQUIRE(perft(board, 4, &hash) == 4085603);
+        REQUIRE(perft(board, 4, &hash) == 4085603);
+        REQUIRE(perft_divide(board, 0).nodes == 1);
+    }
+}
+
+TEST_CASE("Agent has no move once black is mated or stalemated", "[Agent]")
+{
+    // scholar's mate, then black king cornered by a queen and king without being in check
+    for (const char *fen : {"r1bqkb1r/pppp1Qpp/2n2n2/4p3/2B1P3/8/PPPP1PPP/RNB1K1NR b KQkq - 0 4", "7k/5Q2/6K1/8/8/8/8/8 b - - 0 1"}) {
+        Chessboard board{fen};
+        REQUIRE(board.get_legal_moves().empty());
+        Agent agent(board);
+        agent.set_board(board);
+        SearchLimits limits;
+        limits.movetime_ms = 50;
+        SearchResult result = agent.search(limits);
+        REQUIRE(!result.best_move);
+        REQUIRE(!agent.find_best_move(3));
+        REQUIRE(board.fen() == Chessboard(fen).fen());
+        REQUIRE(!board.white_to_move);
+    }
+}
+
+TEST_CASE("Agent finds a mate in one", "[Agent]")
+{
+    Chessboard board;
+    board.move_piece(53, 45);  // f3
+    board.move_piece(12, 28);  // e5
+    board.move_piece(54, 38);  // g4
+    Agent agent(board);
+    Move best = agent.find_best_move(3);
+    REQUIRE(best.start() == 3);
+    REQUIRE(best.end() == 39);  // Qh4#
+}
+
+TEST_CASE("Agent searches without allocating", "[Agent]")
+{
+    Chessboard board;
+    board.move_piece(52, 36);  // e4
+    Agent agent(board);  // the first search straight after construction mustn't grow the history
+
+    long before = allocation_count;
+    Move best = agent.find_best_move(4);
+    long allocations = allocation_count - before;
+
+    REQUIRE(best);
+    REQUIRE(allocations == 0);
+}
+
+TEST_CASE("Iterative deepening respects its limits", "[Agent]")
+{
+    Chessboard board;
+    Agent agent(board);
+
+    SECTION("Depth limit")
+    {
+        SearchLimits limits;
+        limits.depth = 3;
+        SearchResult result = agent.search(limits);
+        REQUIRE(result.depth == 3);
+        REQUIRE(board.is_valid_move(result.best_move.start(), result.best_move.end()));
+    }
+
+    SECTION("Node limit returns the last finished iteration")
+    {
+        SearchLimits limits;
+        limits.nodes = 5000;
+        SearchResult result = agent.search(limits);
+        REQUIRE(result.depth >= 1);
+        REQUIRE(result.depth < limits.depth);
+        REQUIRE(result.nodes <= limits.nodes);
+        REQUIRE(board.is_valid_move(result.best_move.start(), result.best_move.end()));
+    }
+
+    SECTION("Move time")
+    {
+        SearchLimits limits;
+        limits.movetime_ms = 100;
+        SearchResult result = agent.search(limits);
+        REQUIRE(result.time_ms < 300);
+        REQUIRE(result.best_move);
+    }
+
+    SECTION("A mate ends the search early")
+    {
+        board.move_piece(53, 45);  // f3
+        board.move_piece(12, 28);  // e5
+        board.move_piece(54, 38);  // g4
+        agent.set_board(board);
+        SearchResult result = agent.search(SearchLimits{});
+        REQUIRE(result.best_move == Move{3, 39});  // Qh4#
+        REQUIRE(result.score == MATE_SCORE - 1);
+    }
+}
+
+TEST_CASE("Move ordering shrinks the search", "[Agent]")
+{
+    Chessboard board;
+    board.move_piece(52, 36);  // e4
+    board.move_piece(12, 28);  // e5
+    board.move_piece(62, 45);  // Nf3
+    board.move_piece(1, 18);   // Nc6
+    SearchLimits limits;
+    limits.depth = 5;
+
+    Agent unordered(board);
+    unordered.options.move_ordering = false;
+    SearchResult before = unordered.search(limits);
+
+    Agent ordered(board);
+    SearchResult after = ordered.search(limits);
+
+    REQUIRE(after.nodes < before.nodes);
+    REQUIRE(after.branching_factor < before.branching_factor);
+}
+
+TEST_CASE("Move ordering scores", "[Agent]")
+{
+    Chessboard board;
+    board.move_piece(52, 36);  // e4
+    board.move_piece(11, 27);  // d5
+    MoveOrder order;
+    MoveList moves = board.get_legal_moves();
+    int scores[MAX_MOVES];
+    Move tt_move{62, 45};
+    Move capture{36, 27};  // exd5
+    Move killer{57, 42};
+
+    order.update_quiet_cutoff(board, killer, 2, 4);
+    order.score_moves(board, moves, tt_move, 2, scores);
+    REQUIRE(MoveOrder::pick_move(moves, scores, 0) == tt_move);
+    REQUIRE(MoveOrder::pick_move(moves, scores, 1) == capture);
+    REQUIRE(MoveOrder::pick_move(moves, scores, 2) == killer);
+}
+
+TEST_CASE("Static exchange evaluation", "[Agent]")
+{
+    Chessboard board;
+    board.move_piece(52, 36);  // e4
+    board.move_piece(11, 27);  // d5
+
+    SECTION("An even pawn trade")
+    {
+        REQUIRE(static_exchange(board, Move{36, 27}) == 0);  // exd5 Qxd5
+    }
+
+    SECTION("A knight taking a defended pawn")
+    {
+        board.move_piece(36, 27);  // exd5
+        board.move_piece(6, 21);   // Nf6
+        board.move_piece(62, 45);  // Nf3
+        board.move_piece(21, 27);  // Nxd5
+        board.move_piece(45, 28);  // Ne5
+        board.move_piece(8, 16);   // a6
+        REQUIRE(static_exchange(board, Move{28, 13}) == 100 - 320);  // Nxf7 Kxf7
+    }
+
+    SECTION("A queen taking a pawn defended by a rook")
+    {
+        board.move_piece(59, 31);  // Qh5
+        board.move_piece(8, 16);   // a6
+        REQUIRE(static_exchange(board, Move{31, 15}) == 100 - 900);  // Qxh7 Rxh7
+        REQUIRE(static_exchange(board, Move{31, 13}) == 100 - 900);  // Qxf7+ Kxf7
+    }
+
+    SECTION("Only captures are generated for quiescence")
+    {
+        MoveList captures;
+        generate_legal_captures(board, captures);
+        REQUIRE(captures.size() == 1);
+        REQUIRE(captures[0] == Move{36, 27});
+    }
+}
+
+TEST_CASE("Selective search", "[Agent]")
+{
+    Chessboard board;
+    board.move_piece(52, 36);  // e4
+    board.move_piece(12, 28);  // e5
+    board.move_piece(62, 45);  // Nf3
+    board.move_piece(1, 18);   // Nc6
+    SearchLimits limits;
+    limits.depth = 6;
+
+    SECTION("Null moves are taken back exactly")
+    {
+        uint64_t key = board.key;
+        board.make_null_move();
+        REQUIRE(board.white_to_move == false);
+        REQUIRE(board.key == board.compute_key());
+        board.unmake_null_move();
+        REQUIRE(board.key == key);
+        REQUIRE(board.white_to_move == true);
+    }
+
+    SECTION("Pruning and reductions search fewer positions")
+    {
+        Agent full_width(board);
+        SearchOptions &options = full_width.options;
+        options.pvs = options.aspiration = options.null_move = options.lmr = options.futility = options.reverse_futility = false;
+        Agent selective(board);
+        REQUIRE(selective.search(limits).nodes < full_width.search(limits).nodes);
+    }
+
+    SECTION("Every technique can be switched off on its own")
+    {
+        Chessboard mate;
+        mate.move_piece(53, 45);  // f3
+        mate.move_piece(12, 28);  // e5
+        mate.move_piece(54, 38);  // g4
+        for (bool SearchOptions::*option : {&SearchOptions::pvs, &SearchOptions::aspiration, &SearchOptions::null_move,
+                                            &SearchOptions::lmr, &SearchOptions::futility, &SearchOptions::reverse_futility}) {
+            Agent agent(mate);
+            agent.options.*option = false;
+            SearchResult result = agent.search(limits);
+            REQUIRE(result.best_move == Move{3, 39});  // Qh4#
+            REQUIRE(result.score == MATE_SCORE - 1);
+        }
+    }
+}
+
+TEST_CASE("Lazy SMP search", "[Agent]")
+{
+    Chessboard board;
+    board.move_piece(52, 36);  // e4
+    board.move_piece(12, 28);  // e5
+    Agent agent(board);
+    agent.set_threads(4);
+    REQUIRE(agent.threads() == 4);
+
+    SECTION("Finishes the requested depth with a legal move")
+    {
+        SearchLimits limits;
+        limits.depth = 7;
+        SearchResult result = agent.search(limits);
+        REQUIRE(result.depth == 7);
+        REQUIRE(board.is_valid_move(result.best_move.start(), result.best_move.end()));
+    }
+
+    SECTION("The calling thread stops every helper on time")
+    {
+        SearchLimits limits;
+        limits.movetime_ms = 100;
+        SearchResult result = agent.search(limits);
+        REQUIRE(result.time_ms < 400);
+        REQUIRE(result.best_move);
+    }
+
+    SECTION("Finds the same mate as one thread")
+    {
+        Chessboard mate;
+        mate.move_piece(53, 45);  // f3
+        mate.move_piece(12, 28);  // e5
+        mate.move_piece(54, 38);  // g4
+        agent.set_board(mate);
+        SearchResult result = agent.search(SearchLimits{});
+        REQUIRE(result.best_move == Move{3, 39});  // Qh4#
+    }
+}
+
+TEST_CASE("Bench signature", "[Agent]")
+{
+    SECTION("Every bench position is valid")
+    {
+        for (const char *fen : BENCH_POSITIONS) {
+            REQUIRE_NOTHROW(Chessboard(fen));
+        }
+    }
+
+    SECTION("The node count is the same on every run")
+    {
+        BenchResult first = run_bench(3);
+        BenchResult second = run_bench(3);
+        REQUIRE(first.nodes > 0);
+        REQUIRE(second.nodes == first.nodes);
+        REQUIRE(run_bench(4).nodes > first.nodes);
+    }
+}
+
+TEST_CASE("UCI protocol", "[Agent]")
+{
+    std::ostringstream out;
+    UciEngine engine{out};
+
+    SECTION("Handshake and options")
+    {
+        REQUIRE(engine.command("uci"));
+        REQUIRE(engine.command("setoption name Hash value 8"));
+        REQUIRE(engine.command("setoption name Threads value 2"));
+        REQUIRE(engine.command("isready"));
+        REQUIRE(out.str().find("uciok") != std::string::npos);
+        REQUIRE(out.str().find("unknown option") == std::string::npos);
+        REQUIRE(out.str().find("readyok") != std::string::npos);
+        REQUIRE_FALSE(engine.command("quit"));
+    }
+
+    SECTION("Moves are written and read in long algebraic notation")
+    {
+        Chessboard board;
+        for (auto [start, end] : {std::pair{52, 36}, {11, 27}, {36, 27}, {12, 20}, {27, 20}, {3, 39}, {20, 13}, {4, 11}}) {
+            REQUIRE(board.move_piece(start, end));
+        }
+        // white's pawn on f7 can take the knight on g8 and promote
+        for (Move move : board.get_legal_moves()) {
+            REQUIRE(move_from_uci(board, move_to_uci(move)) == move);
+        }
+        REQUIRE(move_from_uci(board, "f7g8q") == Move(13, 6, PROMOTION, QUEEN));
+        REQUIRE(move_to_uci(Move(13, 6, PROMOTION, KNIGHT)) == "f7g8n");
+        REQUIRE_FALSE(move_from_uci(board, "f7g8"));
+        REQUIRE_FALSE(move_from_uci(board, "e2e5"));
+    }
+
+    SECTION("A search from a position with moves finds a mate")
+    {
+        REQUIRE(engine.command("position fen 6k1/5ppp/8/8/8/8/5PPP/6K1 w - - 0 1 moves g1f1 g8f8"));
+        REQUIRE(engine.command("position startpos moves f2f3 e7e5 g2g4"));
+        REQUIRE(engine.command("go depth 3"));
+        engine.wait();
+        REQUIRE(out.str().find("score mate 1") != std::string::npos);
+        REQUIRE(out.str().find("bestmove d8h4") != std::string::npos);
+    }
+
+    SECTION("An infinite search answers isready and waits for stop")
+    {
+        REQUIRE(engine.command("position startpos"));
+        REQUIRE(engine.command("go infinite"));
+        REQUIRE(engine.command("isready"));
+        REQUIRE(out.str().find("readyok") != std::string::npos);
+        REQUIRE(engine.command("stop"));
+        std::string output = out.str();
+        REQUIRE(output.find("bestmove") != std::string::npos);
+        REQUIRE(output.find("readyok") < output.find("bestmove"));
+    }
+
+    SECTION("Bad input is reported, not played")
+    {
+        REQUIRE(engine.command("position startpos moves e2e4 e2e4"));
+        REQUIRE(engine.command("position fen 8/8/8 w - -"));
+        REQUIRE(out.str().find("illegal move e2e4") != std::string::npos);
+        REQUIRE(out.str().find("invalid fen") != std::string::npos);
+    }
+}